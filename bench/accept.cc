@@ -0,0 +1,75 @@
+/**
+ *  @file accept.cc
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ *
+ *  Loopback connections accepted per second through net::acceptor.
+ */
+#include <cstdio>
+#include <cstdlib>
+
+#include <thread>
+#include <vector>
+
+#include <bokasafn/epoll.hh>
+#include <bokasafn/net/acceptor.hh>
+#include <bokasafn/net/socket.hh>
+
+using namespace std::literals::chrono_literals;
+
+int
+main(int argc, char ** argv)
+{
+  using tcp = bokasafn::net::ipv4::tcp;
+
+  std::size_t connections = argc > 1 ? std::strtoul(argv[ 1 ], nullptr, 10) : 20000;
+  std::size_t batch = 64;
+
+  tcp l;
+  l.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  l.bind({"127.0.0.1", 23461});
+  l.listen(4096);
+
+  bokasafn::epoll<64> e;
+  std::size_t accepted = 0;
+  std::size_t wakeups = 0;
+
+  bokasafn::net::acceptor<tcp> acceptor(l, [&](tcp &&, bokasafn::net::saddr const &) {
+    if (++accepted == connections)
+      e.stop();
+  });
+
+  e.add(l.fd(), [&](int) {
+    wakeups++;
+    acceptor.drain();
+    return true;
+  });
+
+  // Clients connect in batches, the accepted sockets are closed right away
+  std::thread clients([&]() {
+    for (std::size_t done = 0; done < connections;)
+    {
+      std::vector<tcp> pending(std::min(batch, connections - done));
+
+      for (auto & c : pending)
+        c.connect({"127.0.0.1", 23461});
+
+      done += pending.size();
+    }
+  });
+
+  auto begin = std::chrono::steady_clock::now();
+
+  while (accepted < connections)
+    e.start(1s);
+
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+  clients.join();
+
+  std::printf("%10zu connections %12.0f accepts/s %8.1f accepts/wakeup\n",
+              accepted,
+              accepted / secs,
+              double(accepted) / wakeups);
+
+  return 0;
+}
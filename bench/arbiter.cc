@@ -0,0 +1,152 @@
+/**
+ *  @file arbiter.cc
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ *
+ *  A/B feed arbitration: net::arbiter against a std::map, then over loopback multicast.
+ */
+#include <cstdio>
+#include <cstdlib>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <bokasafn/net/arbiter.hh>
+#include <bokasafn/net/socket.hh>
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+using arbiter_t = bokasafn::net::arbiter<bokasafn::net::sequence_at<0>>;
+
+struct packet
+{
+  std::uint64_t seq;
+  char payload[ 56 ];
+};
+
+/**
+ * @brief Both lines interleaved, A drops 1/100 and B 1/77
+ */
+std::vector<std::pair<int, packet>>
+feed(std::size_t count)
+{
+  std::vector<std::pair<int, packet>> packets;
+
+  for (std::uint64_t seq = 0; seq < count; ++seq)
+  {
+    packet p{bokasafn::net::htonT(seq), {}};
+
+    if (seq % 100)
+      packets.push_back({0, p});
+    if (seq % 77)
+      packets.push_back({1, p});
+  }
+
+  return packets;
+}
+
+void
+report(char const * name, std::size_t packets, std::size_t delivered, clock_type::duration elapsed)
+{
+  double secs = std::chrono::duration<double>(elapsed).count();
+
+  std::printf("%-20s %10zu packets %10zu delivered %8.1f ns/packet\n", name, packets, delivered, secs * 1e9 / packets);
+}
+
+void
+in_memory(std::size_t count)
+{
+  auto packets = feed(count);
+
+  {
+    std::size_t delivered = 0;
+    auto a = std::make_unique<arbiter_t>([&](std::uint64_t, void const *, std::size_t, int) { delivered++; });
+
+    auto begin = clock_type::now();
+    for (auto const & p : packets)
+      a->process(p.first, &p.second, sizeof(p.second));
+
+    report("arbiter", packets.size(), delivered, clock_type::now() - begin);
+  }
+
+  {
+    // What the application used to do: remember seen sequences, trim the old ones
+    std::size_t delivered = 0;
+    std::map<std::uint64_t, bool> seen;
+
+    auto begin = clock_type::now();
+    for (auto const & p : packets)
+    {
+      auto seq = bokasafn::net::ntohT(p.second.seq);
+
+      if (seen.emplace(seq, true).second)
+        delivered++;
+
+      if (seen.size() > 65536)
+        seen.erase(seen.begin());
+    }
+
+    report("std::map", packets.size(), delivered, clock_type::now() - begin);
+  }
+}
+
+void
+multicast(std::size_t count)
+{
+  auto lo = bokasafn::net::ifindex("lo");
+  bokasafn::net::saddr ga{"239.1.1.1", 23462};
+  bokasafn::net::saddr gb{"239.1.1.2", 23463};
+
+  bokasafn::net::ipv4::udp ra;
+  ra.set_option(bokasafn::net::option<SOL_SOCKET, SO_RCVBUF, int>(4 << 20));
+  ra.bind(ga);
+  ra.join_mgroup(ga, lo);
+
+  bokasafn::net::ipv4::udp rb;
+  rb.set_option(bokasafn::net::option<SOL_SOCKET, SO_RCVBUF, int>(4 << 20));
+  rb.bind(gb);
+  rb.join_mgroup(gb, lo);
+
+  bokasafn::net::ipv4::udp s;
+  s.set_multicast_if(lo);
+
+  std::size_t delivered = 0;
+  auto a = std::make_unique<arbiter_t>([&](std::uint64_t, void const *, std::size_t, int) { delivered++; });
+
+  auto packets = feed(count);
+  std::size_t received = 0;
+
+  auto begin = clock_type::now();
+
+  // Bursts small enough for the socket buffers
+  for (std::size_t i = 0; i < packets.size(); i += 256)
+  {
+    for (std::size_t j = i; j < std::min(i + 256, packets.size()); ++j)
+      s.sendto(packets[ j ].first ? gb : ga, &packets[ j ].second, sizeof(packets[ j ].second));
+
+    received += a->poll(ra, 0);
+    received += a->poll(rb, 1);
+  }
+
+  report("multicast loopback", received, delivered, clock_type::now() - begin);
+
+  std::printf("gaps %lu, B lag p50 %lu ns p99 %lu ns\n",
+              (unsigned long)a->counters().missing,
+              (unsigned long)a->lag[ 1 ].quantile(0.5),
+              (unsigned long)a->lag[ 1 ].quantile(0.99));
+}
+
+} /** ! */
+
+int
+main(int argc, char ** argv)
+{
+  std::size_t count = argc > 1 ? std::strtoul(argv[ 1 ], nullptr, 10) : 1000000;
+
+  in_memory(count);
+  multicast(count / 10);
+
+  return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ *  @file executor.cc
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ *
+ *  Fork-join and scaling of bokasafn::executor.
+ */
+#include <cstdio>
+#include <cstdlib>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <bokasafn/executor.hh>
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+void
+wait_for(std::atomic<long> const & counter)
+{
+  while (counter.load())
+    std::this_thread::yield();
+}
+
+long
+fib(int n)
+{
+  return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+/**
+ * @brief Recursive fibonacci, every node above the cutoff forks two tasks from a worker
+ */
+struct fork
+{
+  bokasafn::executor * e;
+  std::atomic<long> * pending;
+  std::atomic<long> * result;
+  int n;
+
+  void
+  operator()() const
+  {
+    if (n < 20)
+      result->fetch_add(fib(n), std::memory_order_relaxed);
+    else
+    {
+      pending->fetch_add(2, std::memory_order_relaxed);
+      e->submit(fork{e, pending, result, n - 1});
+      e->submit(fork{e, pending, result, n - 2});
+    }
+
+    pending->fetch_sub(1, std::memory_order_release);
+  }
+};
+
+void
+fork_join(std::size_t threads, int n)
+{
+  bokasafn::executor e(threads, true);
+  std::atomic<long> pending{1};
+  std::atomic<long> result{0};
+
+  auto begin = clock_type::now();
+
+  e.submit(fork{&e, &pending, &result, n});
+  wait_for(pending);
+
+  double secs = std::chrono::duration<double>(clock_type::now() - begin).count();
+
+  std::printf("fork-join fib(%d) %2zu threads %10.3f ms  (%ld)\n", n, threads, secs * 1e3, result.load());
+}
+
+/**
+ * @brief Independent small tasks submitted from outside, measures the injection path
+ */
+void
+scaling(std::size_t threads, long tasks)
+{
+  bokasafn::executor e(threads, true);
+  std::atomic<long> pending{tasks};
+
+  auto begin = clock_type::now();
+
+  for (long i = 0; i < tasks; ++i)
+    e.submit([&pending]() {
+      volatile long x = 0;
+      for (int j = 0; j < 256; ++j)
+        x = x + j;
+
+      pending.fetch_sub(1, std::memory_order_release);
+    });
+
+  wait_for(pending);
+
+  double secs = std::chrono::duration<double>(clock_type::now() - begin).count();
+
+  std::printf("scaling %2zu threads %10ld tasks %12.0f tasks/s\n", threads, tasks, tasks / secs);
+}
+
+} /** ! */
+
+int
+main(int argc, char ** argv)
+{
+  int n = argc > 1 ? std::atoi(argv[ 1 ]) : 32;
+  long tasks = argc > 2 ? std::atol(argv[ 2 ]) : 1000000;
+  std::size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+
+  for (std::size_t threads = 1; threads <= cpus; threads *= 2)
+    fork_join(threads, n);
+
+  for (std::size_t threads = 1; threads <= cpus; threads *= 2)
+    scaling(threads, tasks);
+
+  return 0;
+}
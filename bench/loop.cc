@@ -0,0 +1,165 @@
+/**
+ *  @file loop.cc
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ *
+ *  Loopback ping-pong through bokasafn::epoll and bokasafn::uring.
+ */
+#include <cstdio>
+#include <cstdlib>
+
+#include <bokasafn/epoll.hh>
+#include <bokasafn/net/socket.hh>
+#include <bokasafn/uring.hh>
+
+using namespace std::literals::chrono_literals;
+
+namespace
+{
+
+constexpr std::size_t MESSAGE = 64;
+
+template <typename S>
+void
+nonblock(S const & s)
+{
+  s.add_flags(O_NONBLOCK);
+}
+
+void
+report(char const * name, std::size_t rounds, std::chrono::steady_clock::duration elapsed)
+{
+  double secs = std::chrono::duration<double>(elapsed).count();
+
+  std::printf("%-24s %10zu round trips %12.0f msg/s %8.2f us/rtt\n",
+              name,
+              rounds,
+              2 * rounds / secs,
+              secs * 1e6 / rounds);
+}
+
+/**
+ * @brief Both ends live on the same loop, each readiness event costs a recv and a send
+ */
+template <typename Loop, typename S>
+void
+pingpong(char const * name, S const & a, S const & b, std::size_t rounds)
+{
+  Loop e;
+  std::size_t count = 0;
+  char ping[ MESSAGE ] = {};
+
+  auto echo = [](int fd) {
+    char buffer[ MESSAGE ];
+
+    auto n = ::recv(fd, buffer, sizeof(buffer), 0);
+    if (n > 0)
+      ::send(fd, buffer, n, 0);
+
+    return true;
+  };
+
+  e.add(b.fd(), echo);
+  e.add(a.fd(), [&](int fd) {
+    char buffer[ MESSAGE ];
+
+    if (::recv(fd, buffer, sizeof(buffer), 0) > 0 && ++count < rounds)
+      ::send(fd, buffer, sizeof(buffer), 0);
+    else if (count >= rounds)
+      e.stop();
+
+    return true;
+  });
+
+  auto begin = std::chrono::steady_clock::now();
+
+  a.send(ping, sizeof(ping));
+  e.start(1s);
+
+  report(name, rounds, std::chrono::steady_clock::now() - begin);
+}
+
+/**
+ * @brief Same exchange with uring multishot recv, payloads come with the completion
+ */
+template <typename S>
+void
+pingpong_multishot(char const * name, S const & a, S const & b, std::size_t rounds)
+{
+  bokasafn::uring<64> e;
+  std::size_t count = 0;
+  char ping[ MESSAGE ] = {};
+
+  e.recv(b.fd(), [](int fd, void const * data, std::size_t size) {
+    if (data)
+      ::send(fd, data, size, 0);
+
+    return data != nullptr;
+  });
+  e.recv(a.fd(), [&](int fd, void const * data, std::size_t size) {
+    if (data && ++count < rounds)
+      ::send(fd, data, size, 0);
+    else if (count >= rounds)
+      e.stop();
+
+    return data != nullptr;
+  });
+
+  auto begin = std::chrono::steady_clock::now();
+
+  a.send(ping, sizeof(ping));
+  e.start(1s);
+
+  report(name, rounds, std::chrono::steady_clock::now() - begin);
+}
+
+} /** ! */
+
+int
+main(int argc, char ** argv)
+{
+  std::size_t rounds = argc > 1 ? std::strtoul(argv[ 1 ], nullptr, 10) : 200000;
+
+  {
+    bokasafn::net::ipv4::tcp l;
+    l.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+    l.bind({"127.0.0.1", 23456});
+    l.listen(1);
+
+    bokasafn::net::ipv4::tcp a;
+    a.connect({"127.0.0.1", 23456});
+    a.set_option(bokasafn::net::option<IPPROTO_TCP, TCP_NODELAY, int>(true));
+
+    bokasafn::net::saddr peer;
+    auto b = l.accept(peer);
+    b.set_option(bokasafn::net::option<IPPROTO_TCP, TCP_NODELAY, int>(true));
+
+    nonblock(a);
+    nonblock(b);
+
+    pingpong<bokasafn::epoll<64>>("tcp epoll", a, b, rounds);
+    pingpong<bokasafn::uring<64>>("tcp uring poll", a, b, rounds);
+    pingpong_multishot("tcp uring multishot", a, b, rounds);
+  }
+
+  {
+    bokasafn::net::saddr sa{"127.0.0.1", 23457};
+    bokasafn::net::saddr sb{"127.0.0.1", 23458};
+
+    bokasafn::net::ipv4::udp a;
+    a.bind(sa);
+    bokasafn::net::ipv4::udp b;
+    b.bind(sb);
+
+    a.connect(sb);
+    b.connect(sa);
+
+    nonblock(a);
+    nonblock(b);
+
+    pingpong<bokasafn::epoll<64>>("udp epoll", a, b, rounds);
+    pingpong<bokasafn::uring<64>>("udp uring poll", a, b, rounds);
+    pingpong_multishot("udp uring multishot", a, b, rounds);
+  }
+
+  return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ *  @file mmsg.cc
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ *
+ *  Loopback UDP packets/s through sendmmsg/recvmmsg at several batch sizes.
+ */
+#include <cstdio>
+#include <cstdlib>
+
+#include <chrono>
+
+#include <bokasafn/net/socket.hh>
+
+namespace
+{
+
+constexpr std::size_t MESSAGE = 64;
+constexpr std::size_t MAX_BATCH = 64;
+
+/**
+ * @brief Send a batch then receive it back, both sides pay one syscall per batch
+ */
+void
+run(std::size_t batch, std::size_t packets)
+{
+  bokasafn::net::saddr sa{"127.0.0.1", 23459};
+  bokasafn::net::saddr sb{"127.0.0.1", 23460};
+
+  bokasafn::net::ipv4::udp rx;
+  rx.set_option(bokasafn::net::option<SOL_SOCKET, SO_RCVBUF, int>(4 << 20));
+  rx.bind(sa);
+
+  bokasafn::net::ipv4::udp tx;
+  tx.bind(sb);
+  tx.connect(sa);
+
+  static char out[ MAX_BATCH ][ MESSAGE ];
+  static char in[ MAX_BATCH ][ MESSAGE ];
+
+  bokasafn::net::mmsg<MAX_BATCH> txb(out, MESSAGE);
+  bokasafn::net::mmsg<MAX_BATCH> rxb(in, MESSAGE);
+
+  std::size_t received = 0;
+  auto begin = std::chrono::steady_clock::now();
+
+  while (received < packets)
+  {
+    int sent = tx.sendmmsg(txb, batch);
+    if (sent <= 0)
+    {
+      std::perror("sendmmsg");
+      std::exit(1);
+    }
+
+    for (int pending = sent; pending > 0;)
+    {
+      int n = rx.recvmmsg(rxb, pending, MSG_WAITFORONE);
+      if (n <= 0)
+      {
+        std::perror("recvmmsg");
+        std::exit(1);
+      }
+
+      pending -= n;
+      received += n;
+    }
+  }
+
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+  std::printf("batch %2zu %10zu packets %12.0f packets/s\n", batch, received, received / secs);
+}
+
+} /** ! */
+
+int
+main(int argc, char ** argv)
+{
+  std::size_t packets = argc > 1 ? std::strtoul(argv[ 1 ], nullptr, 10) : 2000000;
+
+  for (std::size_t batch : {1, 8, 32, 64})
+    run(batch, packets);
+
+  return 0;
+}
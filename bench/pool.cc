@@ -0,0 +1,133 @@
+/**
+ *  @file pool.cc
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ *
+ *  Buffers/s through malloc/free and through buffer_pool, one at a time and by batches of 64
+ *  released by another thread.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <bokasafn/pool.hh>
+
+namespace
+{
+
+constexpr std::size_t SIZE = 2048;
+constexpr std::size_t BATCH = 64;
+
+char * volatile sink;
+
+template <typename F>
+void
+run(char const * name, std::size_t count, F f)
+{
+  auto begin = std::chrono::steady_clock::now();
+
+  f(count);
+
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+  std::printf("%-14s %10zu buffers %12.0f buffers/s %6.1f ns\n", name, count, count / secs, secs * 1e9 / count);
+}
+
+/**
+ * @brief Batches filled here and freed on a consumer thread, handed over one slot at a time
+ */
+template <typename A, typename R>
+void
+cross(std::size_t count, A acquire, R release)
+{
+  using item_t = decltype(acquire());
+
+  std::vector<item_t> slots(BATCH);
+  std::atomic<std::size_t> ready{0};
+  std::atomic<std::size_t> done{0};
+
+  std::thread consumer([&]() {
+    for (std::size_t round = 1; round <= count / BATCH; ++round)
+    {
+      while (ready.load(std::memory_order_acquire) != round)
+        std::this_thread::yield();
+
+      for (auto & s : slots)
+        release(s);
+
+      done.store(round, std::memory_order_release);
+    }
+  });
+
+  for (std::size_t round = 1; round <= count / BATCH; ++round)
+  {
+    for (auto & s : slots)
+    {
+      s = acquire();
+      std::memset(&*s, 0, 64);
+    }
+
+    ready.store(round, std::memory_order_release);
+
+    while (done.load(std::memory_order_acquire) != round)
+      std::this_thread::yield();
+  }
+
+  consumer.join();
+}
+
+} /** ! */
+
+int
+main(int argc, char ** argv)
+{
+  std::size_t count = argc > 1 ? std::strtoul(argv[ 1 ], nullptr, 10) : 10000000;
+
+  bokasafn::buffer_pool pool(SIZE, 4096);
+  std::printf("huge pages: %s\n", pool.huge() ? "reserved" : "transparent");
+
+  run("malloc", count, [](std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      auto p = static_cast<char *>(std::malloc(SIZE));
+      std::memset(p, 0, 64);
+      sink = p;
+      std::free(sink);
+    }
+  });
+
+  run("pool", count, [&](std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      auto b = pool.acquire();
+      std::memset(b.data(), 0, 64);
+    }
+  });
+
+  run("malloc/cross", count / 10, [](std::size_t n) {
+    cross(
+      n, []() { return static_cast<char *>(std::malloc(SIZE)); }, [](char *& p) { std::free(p); });
+  });
+
+  run("pool/cross", count / 10, [&](std::size_t n) {
+    struct handle
+    {
+      bokasafn::buffer b;
+
+      char &
+      operator*()
+      {
+        return *b.data();
+      }
+    };
+
+    cross(
+      n, [&]() { return handle{pool.acquire()}; }, [](handle & h) { h.b.reset(); });
+  });
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ *  @file saddr.cc
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ *
+ *  Addresses/s built from text, through getaddrinfo + inet_pton and through saddr::parse.
+ */
+#include <netdb.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <chrono>
+#include <string>
+
+#include <bokasafn/net/saddr.hh>
+
+namespace
+{
+
+char const * const INPUTS[] = {"127.0.0.1", "10.200.30.4", "::1", "2001:db8::8a2e:370:7334", "fe80::1:2:3:4"};
+
+/**
+ * @brief What the string constructor used to do: a std::string, a getaddrinfo list, inet_pton
+ */
+bokasafn::net::saddr
+legacy(std::string const & str, std::uint16_t port)
+{
+  struct addrinfo hint = {};
+  struct addrinfo * info = nullptr;
+
+  hint.ai_family = PF_UNSPEC;
+  hint.ai_flags = AI_NUMERICHOST;
+
+  if (getaddrinfo(str.c_str(), nullptr, &hint, &info))
+    return {};
+
+  auto family = info->ai_family;
+  freeaddrinfo(info);
+
+  if (family == AF_INET)
+  {
+    in_addr in;
+    inet_pton(AF_INET, str.c_str(), &in);
+    return {in, port};
+  }
+
+  in6_addr in6;
+  inet_pton(AF_INET6, str.c_str(), &in6);
+  return {in6, port};
+}
+
+template <typename F>
+void
+run(char const * name, std::size_t count, F f)
+{
+  std::size_t sum = 0;
+  auto begin = std::chrono::steady_clock::now();
+
+  for (std::size_t i = 0; i < count; ++i)
+    sum += f(INPUTS[ i % std::size(INPUTS) ]).port();
+
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+  std::printf("%-8s %10zu addresses %12.0f addresses/s %6.1f ns (%zu)\n", name, count, count / secs, secs * 1e9 / count,
+              sum);
+}
+
+} /** ! */
+
+int
+main(int argc, char ** argv)
+{
+  std::size_t count = argc > 1 ? std::strtoul(argv[ 1 ], nullptr, 10) : 1000000;
+
+  run("legacy", count, [](char const * s) { return legacy(s, 1); });
+  run("parse", count, [](std::string_view s) { return bokasafn::net::saddr(s, 1); });
+
+  return 0;
+}
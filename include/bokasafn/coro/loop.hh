@@ -0,0 +1,316 @@
+/**
+ *  @file loop.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_CORO_LOOP_HH_
+#define BOKASAFN_CORO_LOOP_HH_
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include <bokasafn/coro/task.hh>
+#include <bokasafn/exceptions.hh>
+
+namespace bokasafn
+{
+namespace coro
+{
+
+/**
+ * @brief Awaitable view of an event loop (bokasafn::epoll or bokasafn::uring)
+ *
+ * Coroutines are resumed inline from the loop handlers, on the loop thread. A descriptor
+ * stays registered as long as a coroutine awaits it again from its resumption, so a
+ * read loop costs no registration once running. Sleepers share a single timerfd.
+ *
+ * One coroutine at a time may await each direction of a descriptor, a second one gets
+ * EBUSY thrown from its co_await.
+ */
+template <typename E>
+class loop
+{
+private:
+  using clock = std::chrono::steady_clock;
+
+  struct waiter_t
+  {
+    std::coroutine_handle<> in;
+    std::coroutine_handle<> out;
+  };
+
+  struct sleeper_t
+  {
+    clock::time_point deadline;
+    std::coroutine_handle<> h;
+
+    bool
+    operator>(sleeper_t const & other) const
+    {
+      return deadline > other.deadline;
+    }
+  };
+
+  class io_awaiter
+  {
+  public:
+    io_awaiter(loop & l, int fd, int events) : loop_(l), fd_(fd), events_(events) {}
+
+    bool
+    await_ready() const noexcept
+    {
+      return false;
+    }
+
+    void
+    await_suspend(std::coroutine_handle<> h)
+    {
+      loop_.wait(fd_, events_, h);
+    }
+
+    void
+    await_resume() const noexcept
+    {
+    }
+
+  private:
+    loop & loop_;
+    int fd_;
+    int events_;
+  };
+
+  class sleep_awaiter
+  {
+  public:
+    sleep_awaiter(loop & l, clock::time_point deadline) : loop_(l), deadline_(deadline) {}
+
+    bool
+    await_ready() const noexcept
+    {
+      return deadline_ <= clock::now();
+    }
+
+    void
+    await_suspend(std::coroutine_handle<> h)
+    {
+      loop_.sleep_until(deadline_, h);
+    }
+
+    void
+    await_resume() const noexcept
+    {
+    }
+
+  private:
+    loop & loop_;
+    clock::time_point deadline_;
+  };
+
+public:
+  loop(E & e) : e_(e), dispatching_(-1), timer_armed_(false)
+  {
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd_ < 0)
+      throw bokasafn::exceptions::perror("timerfd_create");
+  }
+
+  ~loop()
+  {
+    if (timer_armed_)
+      e_.remove(timer_fd_);
+
+    for (auto const & it : waiters_)
+      e_.remove(it.first);
+
+    ::close(timer_fd_);
+  }
+
+  loop(loop const &) = delete;
+  loop &
+  operator=(loop const &) = delete;
+
+public:
+  io_awaiter
+  readable(int fd)
+  {
+    return {*this, fd, EPOLLIN};
+  }
+
+  io_awaiter
+  writable(int fd)
+  {
+    return {*this, fd, EPOLLOUT};
+  }
+
+  template <typename P, typename R>
+  sleep_awaiter
+  sleep(std::chrono::duration<P, R> dur)
+  {
+    return {*this, clock::now() + std::chrono::duration_cast<clock::duration>(dur)};
+  }
+
+  E &
+  get()
+  {
+    return e_;
+  }
+
+private:
+  static int
+  interest(waiter_t const & w)
+  {
+    return (w.in ? int(EPOLLIN) : 0) | (w.out ? int(EPOLLOUT) : 0);
+  }
+
+  void
+  wait(int fd, int events, std::coroutine_handle<> h)
+  {
+    auto it = waiters_.find(fd);
+    bool armed = it != waiters_.end();
+
+    if (armed && (events == EPOLLIN ? it->second.in : it->second.out))
+    {
+      errno = EBUSY;
+      throw bokasafn::exceptions::perror(events == EPOLLIN ? "readable" : "writable");
+    }
+
+    if (!armed)
+      it = waiters_.emplace(fd, waiter_t{}).first;
+
+    (events == EPOLLIN ? it->second.in : it->second.out) = h;
+
+    if (!armed)
+      e_.add(fd, [this](int fd) { return dispatch(fd); }, EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP);
+
+    // Within dispatch(fd) the new interest is applied once the handler returns
+    if (dispatching_ != fd)
+      e_.modify(fd, interest(it->second));
+  }
+
+  bool
+  dispatch(int fd)
+  {
+    auto it = waiters_.find(fd);
+    if (it == waiters_.end())
+      return false;
+
+    // The loop does not tell which events fired, only ask when both directions wait
+    int ready = POLLIN | POLLOUT;
+    if (it->second.in && it->second.out)
+    {
+      pollfd p{fd, POLLIN | POLLOUT, 0};
+      if (::poll(&p, 1, 0) > 0)
+        ready = p.revents;
+    }
+
+    // Errors and hang-ups resume everybody, the next syscall reports them
+    if (ready & (POLLERR | POLLHUP))
+      ready |= POLLIN | POLLOUT;
+
+    auto in = ready & POLLIN ? std::exchange(it->second.in, nullptr) : nullptr;
+    auto out = ready & POLLOUT ? std::exchange(it->second.out, nullptr) : nullptr;
+
+    auto previous = std::exchange(dispatching_, fd);
+
+    if (in)
+      in.resume();
+    if (out)
+      out.resume();
+
+    dispatching_ = previous;
+
+    it = waiters_.find(fd);
+    if (it == waiters_.end())
+      return false;
+
+    int events = interest(it->second);
+    if (!events)
+    {
+      waiters_.erase(it);
+      return false;
+    }
+
+    e_.modify(fd, events);
+
+    return true;
+  }
+
+  void
+  sleep_until(clock::time_point deadline, std::coroutine_handle<> h)
+  {
+    bool earliest = sleepers_.empty() || deadline < sleepers_.top().deadline;
+
+    sleepers_.push({deadline, h});
+
+    if (earliest)
+      arm(deadline);
+
+    if (!timer_armed_)
+    {
+      timer_armed_ = true;
+      e_.add(timer_fd_, [this](int) { return expire(); });
+    }
+  }
+
+  void
+  arm(clock::time_point deadline)
+  {
+    auto dur = std::max(deadline - clock::now(), clock::duration(1));
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(dur);
+    auto nsecs = std::chrono::duration_cast<std::chrono::nanoseconds>(dur - secs);
+
+    itimerspec ts{{0, 0}, {secs.count(), nsecs.count()}};
+
+    if (timerfd_settime(timer_fd_, 0, &ts, nullptr) < 0)
+      throw bokasafn::exceptions::perror("timerfd_settime");
+  }
+
+  bool
+  expire()
+  {
+    std::uint64_t ticks;
+
+    if (::read(timer_fd_, &ticks, sizeof(ticks)) < 0 && errno != EAGAIN)
+      throw bokasafn::exceptions::perror("timer_read");
+
+    auto now = clock::now();
+
+    while (!sleepers_.empty() && sleepers_.top().deadline <= now)
+    {
+      auto h = sleepers_.top().h;
+
+      sleepers_.pop();
+      h.resume();
+    }
+
+    if (!sleepers_.empty())
+      arm(sleepers_.top().deadline);
+
+    return true;
+  }
+
+private:
+  E & e_;
+  int dispatching_;
+
+  int timer_fd_;
+  bool timer_armed_;
+
+  std::unordered_map<int, waiter_t> waiters_;
+  std::priority_queue<sleeper_t, std::vector<sleeper_t>, std::greater<sleeper_t>> sleepers_;
+};
+
+} /** !coro */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_CORO_LOOP_HH_ */
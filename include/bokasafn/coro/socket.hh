@@ -0,0 +1,121 @@
+/**
+ *  @file socket.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_CORO_SOCKET_HH_
+#define BOKASAFN_CORO_SOCKET_HH_
+
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include <bokasafn/coro/loop.hh>
+#include <bokasafn/coro/task.hh>
+#include <bokasafn/exceptions.hh>
+#include <bokasafn/net/saddr.hh>
+
+namespace bokasafn
+{
+namespace coro
+{
+
+/**
+ * @brief Awaitable operations on a net::socket, which is switched to non-blocking
+ *
+ * Each operation first tries the syscall and only suspends on EAGAIN.
+ */
+template <typename E, typename S>
+class socket
+{
+public:
+  socket(loop<E> & l, S & s) : loop_(l), sock_(s) { sock_.add_flags(O_NONBLOCK); }
+
+public:
+  task<ssize_t>
+  async_recv(void * buffer, std::size_t size, int flags = 0)
+  {
+    for (;;)
+    {
+      auto n = sock_.recv(buffer, size, flags);
+      if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        co_return n;
+
+      co_await loop_.readable(sock_.fd());
+    }
+  }
+
+  task<ssize_t>
+  async_recvfrom(net::saddr & a, void * buffer, std::size_t size)
+  {
+    for (;;)
+    {
+      auto n = sock_.recvfrom(a, buffer, size);
+      if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        co_return n;
+
+      co_await loop_.readable(sock_.fd());
+    }
+  }
+
+  task<ssize_t>
+  async_send(void const * buffer, std::size_t size, int flags = 0)
+  {
+    for (;;)
+    {
+      auto n = sock_.send(buffer, size, flags);
+      if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        co_return n;
+
+      co_await loop_.writable(sock_.fd());
+    }
+  }
+
+  task<ssize_t>
+  async_sendto(net::saddr const & a, void const * buffer, std::size_t size)
+  {
+    for (;;)
+    {
+      auto n = sock_.sendto(a, buffer, size);
+      if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        co_return n;
+
+      co_await loop_.writable(sock_.fd());
+    }
+  }
+
+  /**
+   * @brief Accept a connection, already non-blocking and close-on-exec
+   */
+  task<S>
+  async_accept(net::saddr & a)
+  {
+    for (;;)
+    {
+      socklen_t addrlen = sizeof(net::saddr);
+
+      int fd = ::accept4(sock_.fd(), a.raw(), &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd >= 0)
+        co_return S(fd);
+
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED)
+        throw bokasafn::exceptions::perror("accept4");
+
+      co_await loop_.readable(sock_.fd());
+    }
+  }
+
+public:
+  S &
+  get()
+  {
+    return sock_;
+  }
+
+private:
+  loop<E> & loop_;
+  S & sock_;
+};
+
+} /** !coro */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_CORO_SOCKET_HH_ */
@@ -0,0 +1,379 @@
+/**
+ *  @file task.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_CORO_TASK_HH_
+#define BOKASAFN_CORO_TASK_HH_
+
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include <bokasafn/exceptions.hh>
+
+namespace bokasafn
+{
+namespace coro
+{
+
+/**
+ * @brief Per-thread free lists of coroutine frames
+ *
+ * Frames are rounded up to 64 bytes granules, frames bigger than 1KB go to operator new.
+ * A frame freed on another thread simply joins that thread's list.
+ */
+class frame_pool
+{
+private:
+  static constexpr std::size_t GRANULE = 64;
+  static constexpr std::size_t CLASSES = 16;
+
+  struct node
+  {
+    node * next;
+  };
+
+  struct lists
+  {
+    node * heads[ CLASSES ] = {};
+
+    ~lists()
+    {
+      for (auto head : heads)
+      {
+        while (head)
+        {
+          auto next = head->next;
+          ::operator delete(head);
+          head = next;
+        }
+      }
+    }
+  };
+
+  static lists &
+  local()
+  {
+    thread_local lists l;
+
+    return l;
+  }
+
+public:
+  static void *
+  allocate(std::size_t size)
+  {
+    auto c = (size + GRANULE - 1) / GRANULE;
+    if (c > CLASSES)
+      return ::operator new(size);
+
+    auto & head = local().heads[ c - 1 ];
+    if (!head)
+      return ::operator new(c * GRANULE);
+
+    auto n = head;
+    head = n->next;
+
+    return n;
+  }
+
+  static void
+  deallocate(void * p, std::size_t size) noexcept
+  {
+    auto c = (size + GRANULE - 1) / GRANULE;
+    if (c > CLASSES)
+      return ::operator delete(p);
+
+    auto & head = local().heads[ c - 1 ];
+    auto n = static_cast<node *>(p);
+
+    n->next = head;
+    head = n;
+  }
+};
+
+/**
+ * @brief Frames of every bokasafn coroutine come from frame_pool
+ */
+struct pooled
+{
+  static void *
+  operator new(std::size_t size)
+  {
+    return frame_pool::allocate(size);
+  }
+
+  static void
+  operator delete(void * p, std::size_t size) noexcept
+  {
+    frame_pool::deallocate(p, size);
+  }
+};
+
+template <typename T>
+class task;
+
+namespace detail
+{
+
+template <typename T>
+struct promise_base : pooled
+{
+  struct final_awaiter
+  {
+    bool
+    await_ready() noexcept
+    {
+      return false;
+    }
+
+    template <typename P>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<P> h) noexcept
+    {
+      if (h.promise().continuation)
+        return h.promise().continuation;
+
+      return std::noop_coroutine();
+    }
+
+    void
+    await_resume() noexcept
+    {
+    }
+  };
+
+  std::suspend_always
+  initial_suspend() noexcept
+  {
+    return {};
+  }
+
+  final_awaiter
+  final_suspend() noexcept
+  {
+    return {};
+  }
+
+  void
+  unhandled_exception()
+  {
+    exception = std::current_exception();
+  }
+
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+};
+
+template <typename T>
+struct promise : promise_base<T>
+{
+  task<T>
+  get_return_object();
+
+  template <typename U>
+  void
+  return_value(U && v)
+  {
+    value.emplace(std::forward<U>(v));
+  }
+
+  T &&
+  result()
+  {
+    if (this->exception)
+      std::rethrow_exception(this->exception);
+
+    return std::move(*value);
+  }
+
+  // Move-only and non default constructible results, e.g. sockets
+  std::optional<T> value;
+};
+
+template <>
+struct promise<void> : promise_base<void>
+{
+  task<void>
+  get_return_object();
+
+  void
+  return_void()
+  {
+  }
+
+  void
+  result()
+  {
+    if (exception)
+      std::rethrow_exception(exception);
+  }
+};
+
+} /** !detail */
+
+/**
+ * @brief Lazy coroutine, starts when awaited and resumes its awaiter when done
+ */
+template <typename T = void>
+class task
+{
+public:
+  using promise_type = detail::promise<T>;
+  using handle_t = std::coroutine_handle<promise_type>;
+
+public:
+  explicit task(handle_t h) : h_(h) {}
+  task(task && other) noexcept : h_(std::exchange(other.h_, nullptr)) {}
+  task(task const &) = delete;
+
+  task &
+  operator=(task && other) noexcept
+  {
+    if (this != &other)
+    {
+      if (h_)
+        h_.destroy();
+      h_ = std::exchange(other.h_, nullptr);
+    }
+
+    return *this;
+  }
+
+  ~task()
+  {
+    if (h_)
+      h_.destroy();
+  }
+
+public:
+  /**
+   * @brief Awaiting a moved-from or released task throws EINVAL, there is no result to resume with
+   */
+  bool
+  await_ready() const
+  {
+    if (!h_)
+    {
+      errno = EINVAL;
+      throw bokasafn::exceptions::perror("task");
+    }
+
+    return h_.done();
+  }
+
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<> awaiter) noexcept
+  {
+    h_.promise().continuation = awaiter;
+
+    return h_;
+  }
+
+  decltype(auto)
+  await_resume()
+  {
+    return h_.promise().result();
+  }
+
+public:
+  bool
+  done() const
+  {
+    return !h_ || h_.done();
+  }
+
+  handle_t
+  release()
+  {
+    return std::exchange(h_, nullptr);
+  }
+
+private:
+  handle_t h_;
+};
+
+namespace detail
+{
+
+template <typename T>
+task<T>
+promise<T>::get_return_object()
+{
+  return task<T>{std::coroutine_handle<promise<T>>::from_promise(*this)};
+}
+
+inline task<void>
+promise<void>::get_return_object()
+{
+  return task<void>{std::coroutine_handle<promise<void>>::from_promise(*this)};
+}
+
+/**
+ * @brief Eager coroutine owning itself, frees its frame when it completes
+ */
+struct detached
+{
+  struct promise_type : pooled
+  {
+    detached
+    get_return_object() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_never
+    initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_never
+    final_suspend() noexcept
+    {
+      return {};
+    }
+
+    void
+    return_void() noexcept
+    {
+    }
+
+    /**
+     * @brief Nobody awaits the result, same as an exception escaping a std::thread
+     */
+    void
+    unhandled_exception() noexcept
+    {
+      std::terminate();
+    }
+  };
+};
+
+inline detached
+run_detached(task<void> t)
+{
+  co_await t;
+}
+
+} /** !detail */
+
+/**
+ * @brief Start t now, it runs until its first suspension and then lives on its own
+ *
+ * An exception escaping t calls std::terminate(), catch what t may throw inside it.
+ */
+inline void
+spawn(task<void> t)
+{
+  detail::run_detached(std::move(t));
+}
+
+} /** !coro */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_CORO_TASK_HH_ */
@@ -6,9 +6,11 @@
 #define BOKASAFN_EPOOL_HH_
 
 #include <sys/epoll.h>
+#include <sys/socket.h>
 #include <sys/timerfd.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <functional>
@@ -16,22 +18,64 @@
 #include <list>
 #include <system_error>
 #include <unordered_map>
+#include <vector>
 
 #include <bokasafn/exceptions.hh>
+#include <bokasafn/stats.hh>
 
 namespace bokasafn
 {
 
+/**
+ * @brief Dispatch class of an epoll handler, ready handlers of a higher class run first
+ */
+enum class priority
+{
+  high,
+  normal,
+  low,
+};
+
 /**
  * @brief
+ *
+ * S instruments the loop (see bokasafn::stats), the default records nothing.
  */
-template <std::size_t MAX_EVENTS>
+template <std::size_t MAX_EVENTS, typename S = stats::none>
 class epoll
 {
 public:
   using func_t = std::function<bool(int)>;
 
+  /**
+   * @brief Busy polling settings, see busy_poll()
+   *
+   * After the last event, start() spins on epoll_wait(0) for budget before blocking with the
+   * caller timeout. When adaptive, the budget doubles (up to max) when an event shows up
+   * while spinning or shortly after blocking, and halves (down to min) each time a spin runs
+   * dry, so an idle loop ends up blocking right away.
+   *
+   * A non zero socket_budget (in us) is set as SO_BUSY_POLL on sockets added afterwards,
+   * along with SO_PREFER_BUSY_POLL when prefer is set.
+   */
+  struct busy_poll_t
+  {
+    std::chrono::microseconds budget{0};
+    bool adaptive = false;
+    std::chrono::microseconds min{0};
+    std::chrono::microseconds max{1000};
+    int socket_budget = 0;
+    bool prefer = false;
+  };
+
 private:
+  struct ready_t
+  {
+    int fd;
+    int events;
+    priority prio;
+  };
+
   enum class fd_type_t
   {
     fd,
@@ -43,6 +87,8 @@ private:
     fd_type_t type;
     epoll_event e;
     std::list<std::pair<int, func_t>> funcs;
+    priority prio = priority::normal;
+    std::size_t budget = 0;
 
     template <typename... Args>
     bool
@@ -74,7 +120,14 @@ private:
   };
 
 public:
-  epoll() : running_(false)
+  epoll()
+    : running_(false)
+    , dispatching_(-1)
+    , budget_(0)
+    , dry_(false)
+    , budgeted_(false)
+    , budget_left_(0)
+    , exhausted_(false)
   {
     fd_ = epoll_create1(0);
     if (fd_ < 0)
@@ -91,38 +144,61 @@ public:
     std::chrono::milliseconds timeout = dur;
 
     running_ = true;
+    last_event_ = std::chrono::steady_clock::now();
 
     while (running_)
     {
       std::array<epoll_event, MAX_EVENTS> epoll_events{};
 
-      auto n = epoll_wait(fd_, epoll_events.begin(), MAX_EVENTS, timeout.count());
+      bool spinning = busy_.budget.count() && spinning_since(last_event_);
+
+      // Requeued handlers still have work: only poll for new events
+      bool pending = !backlog_.empty();
+
+      auto n = epoll_wait(
+        fd_, epoll_events.begin(), MAX_EVENTS, spinning || pending ? 0 : timeout.count());
+
+      if (busy_.budget.count())
+        adapt(spinning, n);
+
+      stats::clock::time_point woke;
+      if constexpr (S::enabled)
+      {
+        woke = stats::clock::now();
+        stats_.on_wait(n);
+      }
+
+      std::array<ready_t, MAX_EVENTS> ready;
 
       for (auto i = 0; i < n; ++i)
       {
         int fd = epoll_events[ i ].data.fd;
-        int events = epoll_events[ i ].events;
         auto it = handlers_.find(fd);
+        auto prio = it == handlers_.end() ? priority::normal : it->second.prio;
 
-        if (it == handlers_.end())
-        {
-          // there is no handle for this file descriptor
-          continue;
-        }
+        ready[ i ] = {fd, int(epoll_events[ i ].events), prio};
+      }
 
-        // Call handle on the correct events
-        bool again = it->second.call(events, fd);
+      requeued_.swap(backlog_);
+      backlog_.clear();
 
-        if (again)
+      // Highest class first, fresh events before requeued ones within a class
+      for (auto p : {priority::high, priority::normal, priority::low})
+      {
+        for (auto i = 0; i < n; ++i)
         {
-          if (epoll_ctl(fd_, EPOLL_CTL_MOD, fd, &it->second.e))
-            throw bokasafn::exceptions::perror("epoll_ctl(MOD)");
+          if (ready[ i ].prio == p)
+            dispatch(ready[ i ].fd, ready[ i ].events, woke);
         }
-        else
+
+        for (auto const & r : requeued_)
         {
-          remove(fd);
+          if (r.prio == p)
+            dispatch(r.fd, r.events, woke);
         }
       }
+
+      requeued_.clear();
     }
   }
 
@@ -132,6 +208,152 @@ public:
     running_ = false;
   }
 
+  /**
+   * @brief Enable (or disable with a zero budget) busy polling
+   */
+  void
+  busy_poll(busy_poll_t const & bp)
+  {
+    busy_ = bp;
+    budget_ = bp.adaptive ? std::clamp(bp.budget, bp.min, bp.max) : bp.budget;
+    dry_ = false;
+  }
+
+  /**
+   * @brief Current spin budget, moves between min and max when adaptive
+   */
+  std::chrono::microseconds
+  busy_budget() const
+  {
+    return budget_;
+  }
+
+public:
+  void
+  set_priority(int fd, priority p)
+  {
+    auto it = handlers_.find(fd);
+    if (it != handlers_.end())
+      it->second.prio = p;
+  }
+
+  /**
+   * @brief Work budget of the fd handler per turn, in units chosen by the handler (0: none)
+   */
+  void
+  set_budget(int fd, std::size_t budget)
+  {
+    auto it = handlers_.find(fd);
+    if (it != handlers_.end())
+      it->second.budget = budget;
+  }
+
+  /**
+   * @brief Charge n units of work to the running handler
+   *
+   * Returns false once its budget is spent: the handler should return true right away, it is
+   * then requeued behind the other ready handlers instead of being re-armed.
+   */
+  bool
+  consume(std::size_t n = 1)
+  {
+    if (!budgeted_)
+      return true;
+
+    if (n >= budget_left_)
+    {
+      budget_left_ = 0;
+      exhausted_ = true;
+
+      return false;
+    }
+
+    budget_left_ -= n;
+
+    return true;
+  }
+
+private:
+  void
+  dispatch(int fd, int events, stats::clock::time_point woke)
+  {
+    auto it = handlers_.find(fd);
+
+    if (it == handlers_.end())
+    {
+      // there is no handle for this file descriptor
+      return;
+    }
+
+    stats::clock::time_point begin;
+    if constexpr (S::enabled)
+    {
+      begin = stats::clock::now();
+      stats_.on_lag(begin - woke);
+    }
+
+    budgeted_ = it->second.budget != 0;
+    budget_left_ = it->second.budget;
+    exhausted_ = false;
+
+    // Call handle on the correct events
+    dispatching_ = fd;
+    bool again = it->second.call(events, fd);
+    dispatching_ = -1;
+
+    if constexpr (S::enabled)
+      stats_.on_handler(fd, stats::clock::now() - begin, begin);
+
+    // The handler may have registered other descriptors
+    it = handlers_.find(fd);
+    if (it == handlers_.end())
+      return;
+
+    if (again && exhausted_)
+    {
+      backlog_.push_back({fd, events, it->second.prio});
+    }
+    else if (again)
+    {
+      if (epoll_ctl(fd_, EPOLL_CTL_MOD, fd, &it->second.e))
+        throw bokasafn::exceptions::perror("epoll_ctl(MOD)");
+    }
+    else
+    {
+      remove(fd);
+    }
+  }
+
+  bool
+  spinning_since(std::chrono::steady_clock::time_point last) const
+  {
+    return !dry_ && budget_.count() && std::chrono::steady_clock::now() - last < budget_;
+  }
+
+  void
+  adapt(bool spinning, int n)
+  {
+    auto now = std::chrono::steady_clock::now();
+
+    if (n > 0)
+    {
+      // Caught while spinning, or the blocking wait was short enough to be worth a spin
+      if (busy_.adaptive && (spinning || now - last_event_ < busy_.max))
+        budget_ = std::min(busy_.max, std::max(budget_ * 2, std::chrono::microseconds(1)));
+
+      last_event_ = now;
+      dry_ = false;
+    }
+    else if (spinning && now - last_event_ >= budget_)
+    {
+      // Spun dry: block from now on until the next event
+      if (busy_.adaptive)
+        budget_ = std::max(busy_.min, budget_ / 2);
+
+      dry_ = true;
+    }
+  }
+
 public:
   int
   add(int fd, func_t f, int flags = EPOLLIN, fd_type_t type = fd_type_t::fd)
@@ -149,6 +371,9 @@ public:
       fd_handler_t handle{type, evt, {}};
       handle.add(flags, f);
 
+      if (busy_.socket_budget && type == fd_type_t::fd)
+        busy_poll_socket(fd);
+
       handlers_.emplace(fd, handle);
 
       if (epoll_ctl(fd_, EPOLL_CTL_ADD, fd, &evt))
@@ -165,6 +390,27 @@ public:
     return fd;
   }
 
+  /**
+   * @brief Replace the events fd is armed for
+   *
+   * Called from the fd handler itself, the new mask is applied when the handler returns.
+   */
+  void
+  modify(int fd, int flags)
+  {
+    auto it = handlers_.find(fd);
+    if (it == handlers_.end())
+      return;
+
+    it->second.e.events = EPOLLONESHOT | flags;
+
+    if (fd == dispatching_)
+      return;
+
+    if (epoll_ctl(fd_, EPOLL_CTL_MOD, fd, &it->second.e))
+      throw bokasafn::exceptions::perror("epoll_ctl(MOD)");
+  }
+
   void
   remove(int fd)
   {
@@ -181,6 +427,21 @@ public:
   }
 
 private:
+  void
+  busy_poll_socket(int fd)
+  {
+    // Not a socket, or no CAP_NET_ADMIN to go above net.core.busy_read: stay as we are
+    setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_.socket_budget, sizeof(busy_.socket_budget));
+
+#ifdef SO_PREFER_BUSY_POLL
+    if (busy_.prefer)
+    {
+      int on = 1;
+      setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &on, sizeof(on));
+    }
+#endif
+  }
+
   constexpr timespec
   to_timespec(std::chrono::nanoseconds dur)
   {
@@ -207,13 +468,20 @@ public:
     if (timerfd_settime(fd, 0, &ts, NULL) < 0)
       throw bokasafn::exceptions::perror("timer_settime");
 
-    return add(fd, [dur, f, this](int fd) {
+    stats::clock::time_point deadline;
+    if constexpr (S::enabled)
+      deadline = stats::clock::now() + dur;
+
+    return add(fd, [dur, f, deadline, this](int fd) mutable {
       size_t data = 0;
 
       // Read on timer fd to stop epoll
       if (read(fd, &data, sizeof(data)) < 0)
         throw bokasafn::exceptions::perror("timer_read");
 
+      if constexpr (S::enabled)
+        stats_.on_timer(fd, stats::clock::now() - deadline);
+
       struct itimerspec ts
       {
         {0, 0}, to_timespec(dur)
@@ -223,6 +491,9 @@ public:
 
       if (ret)
       {
+        if constexpr (S::enabled)
+          deadline = stats::clock::now() + dur;
+
         if (timerfd_settime(fd, 0, &ts, NULL) < 0)
           throw bokasafn::exceptions::perror("timer_settime");
       }
@@ -231,9 +502,30 @@ public:
     }, EPOLLIN, fd_type_t::timer);
   }
 
+public:
+  S &
+  stats()
+  {
+    return stats_;
+  }
+
 private:
   bool running_;
   int fd_;
+  int dispatching_;
+
+  busy_poll_t busy_;
+  std::chrono::microseconds budget_;
+  std::chrono::steady_clock::time_point last_event_;
+  bool dry_;
+
+  bool budgeted_;
+  std::size_t budget_left_;
+  bool exhausted_;
+  std::vector<ready_t> backlog_;
+  std::vector<ready_t> requeued_;
+
+  S stats_;
 
   std::unordered_map<int, fd_handler_t> handlers_;
 };
@@ -0,0 +1,512 @@
+/**
+ *  @file executor.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_EXECUTOR_HH_
+#define BOKASAFN_EXECUTOR_HH_
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bokasafn
+{
+
+namespace detail
+{
+
+/**
+ * @brief Type erased callable held in 64 bytes
+ *
+ * Trivially copyable callables up to 56 bytes are stored inline, the others are boxed on the
+ * heap. Being trivially copyable itself, a task can be copied word by word through the deques.
+ */
+struct task_t
+{
+  static constexpr std::size_t WORDS = 8;
+  static constexpr std::size_t INLINE = (WORDS - 1) * sizeof(std::uint64_t);
+
+  using invoke_t = void (*)(void *);
+
+  template <typename F>
+  static task_t
+  make(F && f)
+  {
+    using T = std::decay_t<F>;
+
+    task_t t;
+
+    if constexpr (std::is_trivially_copyable_v<T> && sizeof(T) <= INLINE && alignof(T) <= alignof(std::uint64_t))
+    {
+      t.invoke = [](void * p) { (*static_cast<T *>(p))(); };
+      ::new (t.storage) T(std::forward<F>(f));
+    }
+    else
+    {
+      t.invoke = [](void * p) {
+        std::unique_ptr<T> f(*static_cast<T **>(p));
+        (*f)();
+      };
+      ::new (t.storage) T *(new T(std::forward<F>(f)));
+    }
+
+    return t;
+  }
+
+  void
+  operator()()
+  {
+    invoke(storage);
+  }
+
+  invoke_t invoke;
+  alignas(std::uint64_t) unsigned char storage[ INLINE ];
+};
+
+static_assert(sizeof(task_t) == task_t::WORDS * sizeof(std::uint64_t));
+static_assert(std::is_trivially_copyable_v<task_t>);
+
+/**
+ * @brief Chase-Lev work-stealing deque of tasks, fixed capacity
+ *
+ * The owner pushes and takes at the bottom, thieves steal at the top. A thief may read a
+ * slot being overwritten, slots are arrays of atomic words and the top CAS rejects such reads.
+ */
+template <std::size_t N>
+class deque
+{
+  static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+private:
+  struct slot_t
+  {
+    std::atomic<std::uint64_t> words[ task_t::WORDS ];
+  };
+
+public:
+  bool
+  push(task_t const & t)
+  {
+    auto b = bottom_.load(std::memory_order_relaxed);
+    auto a = top_.load(std::memory_order_acquire);
+
+    if (b - a >= std::int64_t(N))
+      return false;
+
+    store(slots_[ b & (N - 1) ], t);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+
+    return true;
+  }
+
+  bool
+  take(task_t & t)
+  {
+    auto b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto a = top_.load(std::memory_order_relaxed);
+
+    if (a > b)
+    {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    load(slots_[ b & (N - 1) ], t);
+    if (a < b)
+      return true;
+
+    // Last task, race against the thieves
+    bool won = top_.compare_exchange_strong(a, a + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+
+    return won;
+  }
+
+  bool
+  steal(task_t & t)
+  {
+    auto a = top_.load(std::memory_order_acquire);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = bottom_.load(std::memory_order_acquire);
+
+    if (a >= b)
+      return false;
+
+    load(slots_[ a & (N - 1) ], t);
+
+    return top_.compare_exchange_strong(a, a + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+  bool
+  empty() const
+  {
+    return top_.load(std::memory_order_acquire) >= bottom_.load(std::memory_order_acquire);
+  }
+
+private:
+  static void
+  store(slot_t & s, task_t const & t)
+  {
+    std::uint64_t words[ task_t::WORDS ];
+    std::memcpy(words, &t, sizeof(words));
+
+    for (std::size_t i = 0; i < task_t::WORDS; ++i)
+      s.words[ i ].store(words[ i ], std::memory_order_relaxed);
+  }
+
+  static void
+  load(slot_t const & s, task_t & t)
+  {
+    std::uint64_t words[ task_t::WORDS ];
+
+    for (std::size_t i = 0; i < task_t::WORDS; ++i)
+      words[ i ] = s.words[ i ].load(std::memory_order_relaxed);
+
+    std::memcpy(&t, words, sizeof(words));
+  }
+
+private:
+  alignas(64) std::atomic<std::int64_t> top_{0};
+  alignas(64) std::atomic<std::int64_t> bottom_{0};
+  alignas(64) slot_t slots_[ N ];
+};
+
+/**
+ * @brief Bounded multi-producer multi-consumer queue (Vyukov)
+ */
+template <std::size_t N>
+class mpmc
+{
+  static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+private:
+  struct slot_t
+  {
+    std::atomic<std::size_t> seq;
+    task_t task;
+  };
+
+public:
+  mpmc() : slots_(new slot_t[ N ])
+  {
+    for (std::size_t i = 0; i < N; ++i)
+      slots_[ i ].seq.store(i, std::memory_order_relaxed);
+  }
+
+public:
+  bool
+  push(task_t const & t)
+  {
+    auto pos = tail_.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+      auto & s = slots_[ pos & (N - 1) ];
+      auto seq = s.seq.load(std::memory_order_acquire);
+      auto diff = std::intptr_t(seq) - std::intptr_t(pos);
+
+      if (diff == 0)
+      {
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          s.task = t;
+          s.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = tail_.load(std::memory_order_relaxed);
+    }
+  }
+
+  bool
+  pop(task_t & t)
+  {
+    auto pos = head_.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+      auto & s = slots_[ pos & (N - 1) ];
+      auto seq = s.seq.load(std::memory_order_acquire);
+      auto diff = std::intptr_t(seq) - std::intptr_t(pos + 1);
+
+      if (diff == 0)
+      {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          t = s.task;
+          s.seq.store(pos + N, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = head_.load(std::memory_order_relaxed);
+    }
+  }
+
+private:
+  alignas(64) std::atomic<std::size_t> head_{0};
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  std::unique_ptr<slot_t[]> slots_;
+};
+
+} /** !detail */
+
+/**
+ * @brief Work-stealing thread pool
+ *
+ * Tasks submitted from a worker go to its own deque, the others go through a shared injection
+ * queue. Idle workers steal from random victims, then park until something is submitted.
+ * Small trivially copyable callables (lambdas capturing a few pointers or integers) are
+ * submitted without allocation. Pending tasks are drained before the destructor returns.
+ */
+class executor
+{
+public:
+  static constexpr std::size_t DEQUE = 4096;
+  static constexpr std::size_t QUEUE = 16384;
+
+private:
+  struct worker_t
+  {
+    detail::deque<DEQUE> tasks;
+    std::thread thread;
+  };
+
+public:
+  /**
+   * @param threads number of workers, 0 for one per CPU
+   * @param pin     pin worker i to CPU i modulo the CPU count, best effort
+   */
+  explicit executor(std::size_t threads = 0, bool pin = false) : stop_(false), epoch_(0), idle_(0)
+  {
+    if (!threads)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (std::size_t i = 0; i < threads; ++i)
+      workers_.emplace_back(new worker_t);
+
+    for (std::size_t i = 0; i < threads; ++i)
+      workers_[ i ]->thread = std::thread([this, i, pin]() { run(i, pin); });
+  }
+
+  ~executor()
+  {
+    stop_.store(true);
+    epoch_.fetch_add(1);
+    epoch_.notify_all();
+
+    for (auto & w : workers_)
+      w->thread.join();
+  }
+
+  executor(executor const &) = delete;
+  executor &
+  operator=(executor const &) = delete;
+
+public:
+  template <typename F>
+  void
+  submit(F && f)
+  {
+    enqueue(detail::task_t::make(std::forward<F>(f)));
+    wake(1);
+  }
+
+  /**
+   * @brief Submit every callable of [first, last), waking workers once
+   */
+  template <typename It>
+  void
+  bulk_submit(It first, It last)
+  {
+    std::size_t n = 0;
+
+    for (; first != last; ++first, ++n)
+      enqueue(detail::task_t::make(*first));
+
+    wake(n);
+  }
+
+  std::size_t
+  size() const
+  {
+    return workers_.size();
+  }
+
+  /**
+   * @brief Index of the calling worker, -1 outside of this executor
+   */
+  int
+  current() const
+  {
+    return local().owner == this ? int(local().index) : -1;
+  }
+
+private:
+  struct local_t
+  {
+    executor const * owner = nullptr;
+    std::size_t index = 0;
+    std::uint64_t seed = 0;
+  };
+
+  static local_t &
+  local()
+  {
+    thread_local local_t l;
+
+    return l;
+  }
+
+  void
+  enqueue(detail::task_t const & t)
+  {
+    auto & l = local();
+
+    if (l.owner == this && workers_[ l.index ]->tasks.push(t))
+      return;
+
+    while (!injection_.push(t))
+    {
+      // Full, help draining it rather than spinning
+      detail::task_t other;
+      if (injection_.pop(other))
+        other();
+      else
+        std::this_thread::yield();
+    }
+  }
+
+  void
+  wake(std::size_t n)
+  {
+    if (!n)
+      return;
+
+    epoch_.fetch_add(1);
+
+    if (idle_.load())
+    {
+      if (n == 1)
+        epoch_.notify_one();
+      else
+        epoch_.notify_all();
+    }
+  }
+
+  bool
+  find(std::size_t index, detail::task_t & t)
+  {
+    if (workers_[ index ]->tasks.take(t))
+      return true;
+
+    if (injection_.pop(t))
+      return true;
+
+    auto n = workers_.size();
+    if (n < 2)
+      return false;
+
+    auto & seed = local().seed;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      auto victim = (seed + i) % n;
+
+      if (victim != index && workers_[ victim ]->tasks.steal(t))
+        return true;
+    }
+
+    return false;
+  }
+
+  void
+  run(std::size_t index, bool pin)
+  {
+    if (pin)
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &set);
+
+      pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    auto & l = local();
+    l.owner = this;
+    l.index = index;
+    l.seed = 0x9e3779b97f4a7c15ull * (index + 1);
+
+    detail::task_t t;
+
+    for (;;)
+    {
+      bool found = false;
+
+      for (int spin = 0; spin < 64 && !found; ++spin)
+        found = find(index, t);
+
+      if (found)
+      {
+        t();
+        continue;
+      }
+
+      auto epoch = epoch_.load();
+      idle_.fetch_add(1);
+
+      // Anything submitted before the epoch was read is visible now
+      if (find(index, t))
+      {
+        idle_.fetch_sub(1);
+        t();
+        continue;
+      }
+
+      if (stop_.load())
+      {
+        idle_.fetch_sub(1);
+        return;
+      }
+
+      epoch_.wait(epoch);
+      idle_.fetch_sub(1);
+    }
+  }
+
+private:
+  std::atomic<bool> stop_;
+  std::atomic<std::uint32_t> epoch_;
+  std::atomic<std::uint32_t> idle_;
+
+  detail::mpmc<QUEUE> injection_;
+  std::vector<std::unique_ptr<worker_t>> workers_;
+};
+
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_EXECUTOR_HH_ */
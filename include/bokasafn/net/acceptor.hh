@@ -0,0 +1,172 @@
+/**
+ *  @file acceptor.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_ACCEPTOR_HH_
+#define BOKASAFN_NET_ACCEPTOR_HH_
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <functional>
+
+#include <bokasafn/exceptions.hh>
+#include <bokasafn/net/saddr.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief Accept every pending connection of a listening socket per readiness event
+ *
+ * Connections come out of accept4 already non-blocking and close-on-exec. The listener is
+ * switched to non-blocking.
+ *
+ * A spare descriptor is kept for when the process runs out of them: it is closed to accept and
+ * close the pending connections, which empties the backlog instead of leaving a level
+ * triggered listener ready forever. They are counted in refused().
+ */
+template <typename S>
+class acceptor
+{
+public:
+  using accept_t = std::function<void(S &&, typename S::address const &)>;
+
+public:
+  acceptor(S const & listener, accept_t f) : fd_(listener.fd()), f_(f), refused_(0)
+  {
+    listener.add_flags(O_NONBLOCK);
+    reserve();
+  }
+
+  ~acceptor()
+  {
+    if (spare_ >= 0)
+      ::close(spare_);
+  }
+
+  acceptor(acceptor const &) = delete;
+  acceptor &
+  operator=(acceptor const &) = delete;
+
+public:
+  /**
+   * @brief Accept until the backlog is empty
+   *
+   * @return the number of connections accepted
+   */
+  std::size_t
+  drain()
+  {
+    std::size_t n = 0;
+
+    for (;;)
+    {
+      typename S::address a;
+      socklen_t addrlen = sizeof(a);
+
+      int fd = ::accept4(fd_, a.raw(), &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0)
+      {
+        switch (errno)
+        {
+          // The connection died in the backlog
+          case ECONNABORTED:
+          case EPROTO:
+          case EINTR:
+            continue;
+
+          case EMFILE:
+          case ENFILE:
+            if (refuse())
+              continue;
+            return n;
+
+          case EAGAIN:
+          case ENOBUFS:
+          case ENOMEM:
+            return n;
+
+          default:
+            throw bokasafn::exceptions::perror("accept4");
+        }
+      }
+
+      if constexpr (S::family == AF_UNIX)
+        a.received(addrlen);
+
+      n++;
+      f_(S(fd), a);
+    }
+  }
+
+  /**
+   * @brief Connections closed right away for lack of descriptors
+   */
+  std::size_t
+  refused() const
+  {
+    return refused_;
+  }
+
+  template <typename E>
+  void
+  attach(E & e)
+  {
+    e.add(fd_, [this](int) {
+      drain();
+      return true;
+    });
+  }
+
+private:
+  void
+  reserve()
+  {
+    spare_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+  }
+
+  /**
+   * @brief Accept and close one connection with the spare descriptor
+   *
+   * @return false without a spare, taken by another thread since: the backlog stays as is
+   */
+  bool
+  refuse()
+  {
+    if (spare_ < 0)
+    {
+      reserve();
+      return false;
+    }
+
+    ::close(spare_);
+
+    int fd = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd >= 0)
+    {
+      ::close(fd);
+      refused_++;
+    }
+
+    reserve();
+
+    return fd >= 0;
+  }
+
+private:
+  int fd_;
+  accept_t f_;
+  int spare_;
+  std::size_t refused_;
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_ACCEPTOR_HH_ */
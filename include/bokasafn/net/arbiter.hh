@@ -0,0 +1,341 @@
+/**
+ *  @file arbiter.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_ARBITER_HH_
+#define BOKASAFN_NET_ARBITER_HH_
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+#include <bokasafn/net/saddr.hh>
+#include <bokasafn/stats.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief Sequence number as an unsigned big endian integer at OFFSET of the datagram
+ */
+template <std::size_t OFFSET, typename T = std::uint64_t>
+struct sequence_at
+{
+  bool
+  operator()(void const * data, std::size_t size, std::uint64_t & seq) const
+  {
+    if (size < OFFSET + sizeof(T))
+      return false;
+
+    T v;
+    std::memcpy(&v, static_cast<char const *>(data) + OFFSET, sizeof(v));
+    seq = ntohT(v);
+
+    return true;
+  }
+};
+
+/**
+ * @brief A/B line arbitration of a sequenced feed
+ *
+ * The first copy of each sequence number is delivered, the other one is dropped. A bitmap ring
+ * of WINDOW bits remembers what was seen since the oldest unconfirmed sequence. A sequence is
+ * confirmed once both lines are past it, a gap is reported when it was seen on neither. With
+ * a silent line, sequences are confirmed when they leave the window, or once older than the
+ * max_age() when one is set.
+ *
+ * Worst case, a gap behind a silent line is reported WINDOW sequences later, or with a max age,
+ * by the first process() or expire() call made max age after the next sequence arrived.
+ *
+ * A jump ahead of more than the window reports the missing sequences at once instead of
+ * walking them. A sequence more than the window behind the confirmed one is taken as a feed
+ * restart: the arbiter starts over from it.
+ *
+ * X extracts the sequence: bool(void const * data, size_t size, uint64_t & seq).
+ */
+template <typename X, std::size_t WINDOW = 65536>
+class arbiter
+{
+  static_assert((WINDOW & (WINDOW - 1)) == 0, "window must be a power of two");
+
+public:
+  using deliver_t = std::function<void(std::uint64_t, void const *, std::size_t, int)>;
+  using gap_t = std::function<void(std::uint64_t, std::uint64_t)>;
+
+  struct counters_t
+  {
+    std::uint64_t delivered = 0;
+    std::uint64_t duplicates = 0;
+    std::uint64_t stale = 0;
+    std::uint64_t invalid = 0;
+    std::uint64_t missing = 0;
+    std::uint64_t resets = 0;
+    std::array<std::uint64_t, 2> won{};
+  };
+
+public:
+  arbiter(deliver_t deliver, X extract = X()) : extract_(extract), deliver_(deliver), started_(false), max_age_(0)
+  {
+  }
+
+public:
+  void
+  on_gap(gap_t f)
+  {
+    gap_ = f;
+  }
+
+  /**
+   * @brief Confirm sequences first seen more than age ago, 0 (the default) waits for both lines
+   *
+   * Copies arriving later on the other line are then counted as stale.
+   */
+  void
+  max_age(std::chrono::nanoseconds age)
+  {
+    max_age_ = age.count();
+  }
+
+  /**
+   * @brief Arbitrate a datagram received on line 0 (A) or 1 (B) at the given time
+   *
+   * @return whether it was delivered
+   */
+  bool
+  process(int line, void const * data, std::size_t size, stats::clock::time_point at = stats::clock::now())
+  {
+    std::uint64_t seq;
+
+    if (!extract_(data, size, seq))
+    {
+      counters_.invalid++;
+      return false;
+    }
+
+    if (!started_)
+      restart(seq);
+    else if (seq < confirmed_ && confirmed_ - seq > WINDOW)
+    {
+      counters_.resets++;
+      restart(seq);
+    }
+
+    if (seq < confirmed_)
+    {
+      counters_.stale++;
+      return false;
+    }
+
+    // A silent line must not hold more than the window
+    if (seq - confirmed_ >= WINDOW)
+      confirm(seq - WINDOW + 1);
+
+    high_[ line ] = std::max(high_[ line ], seq + 1);
+
+    auto slot = seq & (WINDOW - 1);
+    auto word = slot / 64;
+    auto bit = std::uint64_t(1) << (slot % 64);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(at.time_since_epoch()).count();
+
+    bool delivered = !(seen_[ word ] & bit);
+
+    if (delivered)
+    {
+      seen_[ word ] |= bit;
+      first_[ slot ] = ns;
+
+      counters_.delivered++;
+      counters_.won[ line ]++;
+
+      deliver_(seq, data, size, line);
+    }
+    else
+    {
+      counters_.duplicates++;
+      lag[ line ].add(std::uint64_t(std::max<std::int64_t>(ns - first_[ slot ], 0)));
+    }
+
+    confirm(std::min(high_[ 0 ], high_[ 1 ]));
+    expire(at);
+
+    return delivered;
+  }
+
+  /**
+   * @brief Confirm up to the last sequence older than the max age
+   *
+   * process() calls it, a timer should too when both lines can go quiet.
+   */
+  void
+  expire(stats::clock::time_point now = stats::clock::now())
+  {
+    if (!started_ || max_age_ <= 0)
+      return;
+
+    auto cutoff = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count() - max_age_;
+    auto end = std::max(high_[ 0 ], high_[ 1 ]);
+    auto upto = confirmed_;
+
+    // Arrivals follow the sequence, the first young one ends the scan
+    for (auto seq = confirmed_; seq < end; ++seq)
+    {
+      auto slot = seq & (WINDOW - 1);
+      if (!(seen_[ slot / 64 ] & (std::uint64_t(1) << (slot % 64))))
+        continue;
+
+      if (first_[ slot ] > cutoff)
+        break;
+
+      upto = seq + 1;
+    }
+
+    confirm(upto);
+  }
+
+  /**
+   * @brief Receive and arbitrate every datagram queued on s, the socket of line
+   */
+  template <typename S>
+  std::size_t
+  poll(S const & s, int line)
+  {
+    std::size_t n = 0;
+    char buffer[ 65536 ];
+
+    for (;;)
+    {
+      auto size = s.recv(buffer, sizeof(buffer), MSG_DONTWAIT);
+      if (size < 0)
+        return n;
+
+      process(line, buffer, size);
+      n++;
+    }
+  }
+
+  /**
+   * @brief Poll line A and B sockets from the loop
+   */
+  template <typename E, typename S>
+  void
+  attach(E & e, S const & a, S const & b)
+  {
+    e.add(a.fd(), [this, &a](int) {
+      poll(a, 0);
+      return true;
+    });
+    e.add(b.fd(), [this, &b](int) {
+      poll(b, 1);
+      return true;
+    });
+  }
+
+public:
+  counters_t const &
+  counters() const
+  {
+    return counters_;
+  }
+
+  /**
+   * @brief Oldest sequence not confirmed yet
+   */
+  std::uint64_t
+  confirmed() const
+  {
+    return confirmed_;
+  }
+
+public:
+  /**
+   * @brief Per line, how late its copies arrived behind the other line's (ns)
+   */
+  std::array<stats::histogram, 2> lag;
+
+private:
+  void
+  restart(std::uint64_t seq)
+  {
+    started_ = true;
+    confirmed_ = seq;
+    high_[ 0 ] = high_[ 1 ] = seq;
+
+    seen_.fill(0);
+  }
+
+  void
+  confirm(std::uint64_t upto)
+  {
+    if (upto <= confirmed_)
+      return;
+
+    std::uint64_t gap = 0;
+
+    // Nothing was seen past the window, walk it then jump
+    auto end = upto - confirmed_ > WINDOW ? confirmed_ + WINDOW : upto;
+
+    for (; confirmed_ < end; ++confirmed_)
+    {
+      auto slot = confirmed_ & (WINDOW - 1);
+      auto & word = seen_[ slot / 64 ];
+      auto bit = std::uint64_t(1) << (slot % 64);
+
+      if (word & bit)
+      {
+        word &= ~bit;
+        report(confirmed_, gap);
+        gap = 0;
+      }
+      else
+        gap++;
+    }
+
+    if (confirmed_ < upto)
+    {
+      gap += upto - confirmed_;
+      confirmed_ = upto;
+    }
+
+    report(confirmed_, gap);
+  }
+
+  void
+  report(std::uint64_t end, std::uint64_t count)
+  {
+    if (!count)
+      return;
+
+    counters_.missing += count;
+
+    if (gap_)
+      gap_(end - count, count);
+  }
+
+private:
+  X extract_;
+  deliver_t deliver_;
+  gap_t gap_;
+
+  bool started_;
+  std::int64_t max_age_;
+  std::uint64_t confirmed_ = 0;
+  std::uint64_t high_[ 2 ] = {};
+
+  std::array<std::uint64_t, WINDOW / 64> seen_{};
+  std::array<std::int64_t, WINDOW> first_{};
+
+  counters_t counters_;
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_ARBITER_HH_ */
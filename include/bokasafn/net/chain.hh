@@ -0,0 +1,167 @@
+/**
+ *  @file chain.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_CHAIN_HH_
+#define BOKASAFN_NET_CHAIN_HH_
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <bokasafn/pool.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief Ordered slices of memory sent as one stream, without concatenating them
+ *
+ * A slice keeps its owner alive until it is fully consumed, pooled buffers are held as they
+ * are, without a shared_ptr control block. Slices appended by reference belong to the caller,
+ * who keeps them alive as long as they are in the chain.
+ */
+class chain
+{
+private:
+  struct slice_t
+  {
+    std::shared_ptr<void const> owner;
+    buffer pooled;
+    char const * data;
+    std::size_t size;
+  };
+
+public:
+  /**
+   * @brief Append size bytes at data, kept alive by owner
+   */
+  void
+  append(std::shared_ptr<void const> owner, void const * data, std::size_t size)
+  {
+    if (size)
+      slices_.push_back({std::move(owner), {}, static_cast<char const *>(data), size});
+    size_ += size;
+  }
+
+  /**
+   * @brief Append a pooled buffer, back to its pool once consumed
+   */
+  void
+  append(buffer && b)
+  {
+    auto data = b.data();
+    auto size = b.size();
+
+    if (size)
+      slices_.push_back({nullptr, std::move(b), data, size});
+    size_ += size;
+  }
+
+  void
+  append(std::string && s)
+  {
+    auto owner = std::make_shared<std::string>(std::move(s));
+
+    append(owner, owner->data(), owner->size());
+  }
+
+  void
+  append(std::vector<char> && v)
+  {
+    auto owner = std::make_shared<std::vector<char>>(std::move(v));
+
+    append(owner, owner->data(), owner->size());
+  }
+
+  /**
+   * @brief Append memory owned by the caller
+   */
+  void
+  append_ref(void const * data, std::size_t size)
+  {
+    append(nullptr, data, size);
+  }
+
+  /**
+   * @brief Drop the first n bytes, after a partial write
+   */
+  void
+  consume(std::size_t n)
+  {
+    size_ -= std::min(n, size_);
+
+    while (n && !slices_.empty())
+    {
+      auto & s = slices_.front();
+
+      if (n < s.size)
+      {
+        s.data += n;
+        s.size -= n;
+        return;
+      }
+
+      n -= s.size;
+      slices_.pop_front();
+    }
+  }
+
+  /**
+   * @brief Describe at most max leading slices in iov
+   *
+   * @return the number of iovec filled
+   */
+  std::size_t
+  iov(iovec * iov, std::size_t max) const
+  {
+    std::size_t i = 0;
+
+    for (auto it = slices_.begin(); it != slices_.end() && i < max; ++it, ++i)
+      iov[ i ] = {const_cast<char *>(it->data), it->size};
+
+    return i;
+  }
+
+  void
+  clear()
+  {
+    slices_.clear();
+    size_ = 0;
+  }
+
+public:
+  std::size_t
+  size() const
+  {
+    return size_;
+  }
+
+  std::size_t
+  count() const
+  {
+    return slices_.size();
+  }
+
+  bool
+  empty() const
+  {
+    return !size_;
+  }
+
+private:
+  std::deque<slice_t> slices_;
+  std::size_t size_ = 0;
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_CHAIN_HH_ */
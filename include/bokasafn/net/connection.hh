@@ -0,0 +1,390 @@
+/**
+ *  @file connection.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_CONNECTION_HH_
+#define BOKASAFN_NET_CONNECTION_HH_
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <span>
+
+#include <bokasafn/utils/ring.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief Buffered non-blocking stream connection driven by the loop
+ *
+ * Both directions go through a mirrored ring, so the data callback always sees the received
+ * bytes contiguous and returns how many it used, the rest stays for the next call.
+ *
+ * - Reading pauses once the unused input reaches the receive high watermark, and resumes
+ *   when consume() brings it under the low one.
+ * - send() queues what the socket does not take and refuses what does not fit. Above the
+ *   send high watermark writable() turns false, the drain callback tells when the queue went
+ *   back under the low one.
+ * - EPOLLOUT is only asked for while bytes are queued.
+ *
+ * Callbacks must not destroy the connection, the close callback is the last one called.
+ */
+template <typename S>
+class connection
+{
+public:
+  struct config_t
+  {
+    std::size_t rx = 1 << 16;
+    std::size_t tx = 1 << 16;
+
+    /**
+     * @brief Watermarks, 0 for 3/4 and 1/4 of the ring
+     */
+    std::size_t rx_high = 0;
+    std::size_t rx_low = 0;
+    std::size_t tx_high = 0;
+    std::size_t tx_low = 0;
+  };
+
+  using data_t = std::function<std::size_t(char const *, std::size_t)>;
+  using drain_t = std::function<void()>;
+  using close_t = std::function<void(int)>;
+
+public:
+  connection(S && s, config_t const & config = {})
+    : socket_(std::move(s)), rx_(config.rx), tx_(config.tx), paused_(false), blocked_(false), closed_(false),
+      handling_(false), interest_(EPOLLIN)
+  {
+    socket_.add_flags(O_NONBLOCK);
+
+    rx_high_ = config.rx_high ? config.rx_high : rx_.capacity() / 4 * 3;
+    rx_low_ = config.rx_low ? config.rx_low : rx_.capacity() / 4;
+    tx_high_ = config.tx_high ? config.tx_high : tx_.capacity() / 4 * 3;
+    tx_low_ = config.tx_low ? config.tx_low : tx_.capacity() / 4;
+  }
+
+  ~connection()
+  {
+    // Also after a close from a handler, before the socket gives the descriptor number back
+    if (detach_)
+      detach_();
+  }
+
+  connection(connection const &) = delete;
+  connection &
+  operator=(connection const &) = delete;
+
+public:
+  /**
+   * @brief Serve the connection from the loop, which must outlive it
+   *
+   * @param data  f(data, size) called with the unused input, returns the bytes it used
+   * @param drain called when the send queue went from above the high to under the low watermark
+   * @param close called once with 0 when the peer closed, an errno otherwise
+   */
+  template <typename E>
+  void
+  attach(E & e, data_t data, drain_t drain = {}, close_t close = {})
+  {
+    data_ = data;
+    drain_ = drain;
+    close_ = close;
+
+    int fd = socket_.fd();
+
+    // One handler, so that closing from it always makes the loop drop the descriptor
+    e.add(fd, [this](int) { return handle(); }, EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP);
+
+    modify_ = [&e, fd](int flags) { e.modify(fd, flags); };
+    detach_ = [&e, fd]() { e.remove(fd); };
+
+    interest_ = -1;
+    update();
+  }
+
+  /**
+   * @brief Send or queue size bytes
+   *
+   * @return false when they do not fit in the send ring, nothing was sent then
+   */
+  bool
+  send(void const * buffer, std::size_t size)
+  {
+    if (closed_ || size > tx_.space())
+      return false;
+
+    auto p = static_cast<char const *>(buffer);
+
+    if (tx_.empty())
+    {
+      auto n = ::send(socket_.fd(), p, size, MSG_NOSIGNAL);
+      if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        fail(errno);
+        return false;
+      }
+
+      if (n > 0)
+      {
+        p += n;
+        size -= std::size_t(n);
+      }
+    }
+
+    if (!size)
+      return true;
+
+    std::memcpy(tx_.room(), p, size);
+    tx_.commit(size);
+
+    if (tx_.size() >= tx_high_)
+      blocked_ = true;
+
+    update();
+
+    return true;
+  }
+
+  /**
+   * @brief Send queue under the high watermark
+   */
+  bool
+  writable() const
+  {
+    return !blocked_;
+  }
+
+  /**
+   * @brief Input left unused by the data callback
+   */
+  std::span<char const>
+  input() const
+  {
+    return {rx_.data(), rx_.size()};
+  }
+
+  /**
+   * @brief Drop n bytes of input used outside of the data callback
+   */
+  void
+  consume(std::size_t n)
+  {
+    rx_.consume(n);
+
+    if (paused_ && rx_.size() <= rx_low_)
+    {
+      paused_ = false;
+      update();
+    }
+  }
+
+  std::size_t
+  queued() const
+  {
+    return tx_.size();
+  }
+
+  bool
+  paused() const
+  {
+    return paused_;
+  }
+
+  bool
+  closed() const
+  {
+    return closed_;
+  }
+
+  S &
+  socket()
+  {
+    return socket_;
+  }
+
+private:
+  /**
+   * @brief Serve whatever the interest asked for, false once closed so the loop forgets the descriptor
+   *
+   * The loop does not tell which events fired: reading and flushing report errors on their
+   * own, and with no interest only an error or a hangup wakes the handler.
+   */
+  bool
+  handle()
+  {
+    int armed = interest_;
+
+    handling_ = true;
+
+    if (!paused_)
+      readable();
+    if (!closed_ && !tx_.empty())
+      flush();
+    if (!closed_ && !armed)
+      hangup();
+
+    handling_ = false;
+
+    if (closed_)
+      return false;
+
+    update();
+
+    return true;
+  }
+
+  void
+  readable()
+  {
+    while (!closed_ && !paused_)
+    {
+      auto space = rx_.space();
+      if (!space)
+      {
+        paused_ = true;
+        break;
+      }
+
+      auto n = ::recv(socket_.fd(), rx_.room(), space, 0);
+      if (n > 0)
+      {
+        rx_.commit(std::size_t(n));
+        deliver();
+
+        // Short read, the socket is most likely drained
+        if (std::size_t(n) < space)
+          break;
+
+        continue;
+      }
+
+      if (!n)
+        fail(0);
+      else if (errno == EINTR)
+        continue;
+      else if (errno != EAGAIN && errno != EWOULDBLOCK)
+        fail(errno);
+
+      break;
+    }
+  }
+
+  void
+  flush()
+  {
+    while (!tx_.empty())
+    {
+      auto n = ::send(socket_.fd(), tx_.data(), tx_.size(), MSG_NOSIGNAL);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+          fail(errno);
+        break;
+      }
+
+      tx_.consume(std::size_t(n));
+    }
+
+    if (!closed_ && blocked_ && tx_.size() <= tx_low_)
+    {
+      blocked_ = false;
+      if (drain_)
+        drain_();
+    }
+  }
+
+  /**
+   * @brief Reported whatever the interest, even while reading is paused
+   */
+  void
+  hangup()
+  {
+    int error = 0;
+    socklen_t len = sizeof(error);
+
+    getsockopt(socket_.fd(), SOL_SOCKET, SO_ERROR, &error, &len);
+    fail(error);
+  }
+
+  void
+  deliver()
+  {
+    if (!rx_.empty())
+      rx_.consume(data_(rx_.data(), rx_.size()));
+
+    if (rx_.size() >= rx_high_)
+      paused_ = true;
+  }
+
+  void
+  fail(int error)
+  {
+    if (closed_)
+      return;
+
+    closed_ = true;
+
+    // From a handler, the loop drops the descriptor once it returns
+    if (detach_ && !handling_)
+      detach_();
+
+    if (close_)
+      close_(error);
+  }
+
+  /**
+   * @brief Arm for input unless paused, for output while bytes are queued
+   */
+  void
+  update()
+  {
+    if (!modify_ || closed_)
+      return;
+
+    int flags = (paused_ ? 0 : int(EPOLLIN)) | (tx_.empty() ? 0 : int(EPOLLOUT));
+    if (flags == interest_)
+      return;
+
+    interest_ = flags;
+    modify_(flags);
+  }
+
+private:
+  S socket_;
+  utils::mirrored_ring rx_;
+  utils::mirrored_ring tx_;
+
+  std::size_t rx_high_;
+  std::size_t rx_low_;
+  std::size_t tx_high_;
+  std::size_t tx_low_;
+
+  bool paused_;
+  bool blocked_;
+  bool closed_;
+  bool handling_;
+  int interest_;
+
+  data_t data_;
+  drain_t drain_;
+  close_t close_;
+
+  std::function<void(int)> modify_;
+  std::function<void()> detach_;
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_CONNECTION_HH_ */
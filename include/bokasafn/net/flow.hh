@@ -0,0 +1,287 @@
+/**
+ *  @file flow.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_FLOW_HH_
+#define BOKASAFN_NET_FLOW_HH_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <bokasafn/net/saddr.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief Source, destination and protocol of a datagram or a connection
+ */
+struct flow
+{
+  saddr source;
+  saddr destination;
+  std::uint8_t protocol;
+};
+
+inline bool
+operator==(flow const & lhs, flow const & rhs)
+{
+  return lhs.protocol == rhs.protocol && lhs.source == rhs.source && lhs.destination == rhs.destination;
+}
+
+} /** !net */
+} /** !bokasafn */
+
+template <>
+struct std::hash<bokasafn::net::flow>
+{
+  std::size_t
+  operator()(bokasafn::net::flow const & f) const noexcept
+  {
+    std::hash<bokasafn::net::saddr> h;
+
+    return bokasafn::net::detail::mix(h(f.source) ^ (h(f.destination) + f.protocol));
+  }
+};
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief Open addressing map from a peer (saddr, flow...) to its state, with idle expiry
+ *
+ * Linear probing over a power of two table kept under 3/4 full, the table doubles beyond.
+ * Erasing shifts the following entries back instead of leaving tombstones, so lookups stay
+ * short however many peers come and go. expire() visits a bounded number of slots per call
+ * and resumes where it stopped, to spread the sweep over the loop iterations.
+ */
+template <typename K, typename V, typename H = std::hash<K>>
+class flow_table
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+private:
+  struct slot_t
+  {
+    std::uint64_t hash = 0;
+    clock::time_point seen;
+    K key;
+    V value;
+  };
+
+public:
+  explicit flow_table(std::size_t capacity = 1024) : size_(0), cursor_(0)
+  {
+    std::size_t n = 8;
+    while (n < capacity)
+      n <<= 1;
+
+    slots_.resize(n);
+    mask_ = n - 1;
+  }
+
+public:
+  V *
+  find(K const & k)
+  {
+    auto i = lookup(k, hash(k));
+
+    return i == NONE ? nullptr : &slots_[ i ].value;
+  }
+
+  /**
+   * @brief State of k, default constructed on first sight, marked as seen at now
+   */
+  V &
+  touch(K const & k, clock::time_point now = clock::now())
+  {
+    auto h = hash(k);
+
+    for (auto i = h & mask_;; i = (i + 1) & mask_)
+    {
+      auto & s = slots_[ i ];
+
+      if (!s.hash)
+      {
+        if ((size_ + 1) * 4 > slots_.size() * 3)
+        {
+          grow();
+          return touch(k, now);
+        }
+
+        s.hash = h;
+        s.seen = now;
+        s.key = k;
+        size_++;
+
+        return s.value;
+      }
+
+      if (s.hash == h && s.key == k)
+      {
+        s.seen = now;
+        return s.value;
+      }
+    }
+  }
+
+  bool
+  erase(K const & k)
+  {
+    auto i = lookup(k, hash(k));
+    if (i == NONE)
+      return false;
+
+    remove(i);
+
+    return true;
+  }
+
+  /**
+   * @brief Remove the flows not seen for longer than idle, f(K const &, V &) is called first
+   *
+   * @param budget slots to visit, capacity() for a full sweep
+   * @return the number of flows removed
+   */
+  template <typename F>
+  std::size_t
+  expire(clock::time_point now, clock::duration idle, std::size_t budget, F f)
+  {
+    std::size_t n = 0;
+
+    while (budget)
+    {
+      auto & s = slots_[ cursor_ ];
+
+      if (s.hash && now - s.seen > idle)
+      {
+        f(s.key, s.value);
+        remove(cursor_);
+        n++;
+
+        // The next entry may have been shifted here, look again
+        continue;
+      }
+
+      cursor_ = (cursor_ + 1) & mask_;
+      budget--;
+    }
+
+    return n;
+  }
+
+  template <typename F>
+  void
+  for_each(F f)
+  {
+    for (auto & s : slots_)
+    {
+      if (s.hash)
+        f(s.key, s.value);
+    }
+  }
+
+  std::size_t
+  size() const
+  {
+    return size_;
+  }
+
+  std::size_t
+  capacity() const
+  {
+    return slots_.size();
+  }
+
+  bool
+  empty() const
+  {
+    return !size_;
+  }
+
+private:
+  static constexpr std::size_t NONE = ~std::size_t(0);
+
+  /**
+   * @brief Never 0, which marks the empty slots
+   */
+  static std::uint64_t
+  hash(K const & k)
+  {
+    return detail::mix(H()(k)) | (std::uint64_t(1) << 63);
+  }
+
+  std::size_t
+  lookup(K const & k, std::uint64_t h) const
+  {
+    for (auto i = h & mask_;; i = (i + 1) & mask_)
+    {
+      auto const & s = slots_[ i ];
+
+      if (!s.hash)
+        return NONE;
+
+      if (s.hash == h && s.key == k)
+        return i;
+    }
+  }
+
+  void
+  remove(std::size_t i)
+  {
+    for (auto j = (i + 1) & mask_; slots_[ j ].hash; j = (j + 1) & mask_)
+    {
+      // An entry may fill the hole unless its home lies between the hole and itself
+      auto home = slots_[ j ].hash & mask_;
+
+      if (((j - home) & mask_) >= ((j - i) & mask_))
+      {
+        slots_[ i ] = std::move(slots_[ j ]);
+        i = j;
+      }
+    }
+
+    slots_[ i ] = slot_t();
+    size_--;
+  }
+
+  void
+  grow()
+  {
+    std::vector<slot_t> old(slots_.size() * 2);
+    old.swap(slots_);
+    mask_ = slots_.size() - 1;
+    cursor_ = 0;
+
+    for (auto & s : old)
+    {
+      if (!s.hash)
+        continue;
+
+      auto i = s.hash & mask_;
+      while (slots_[ i ].hash)
+        i = (i + 1) & mask_;
+
+      slots_[ i ] = std::move(s);
+    }
+  }
+
+private:
+  std::size_t mask_;
+  std::size_t size_;
+  std::size_t cursor_;
+  std::vector<slot_t> slots_;
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_FLOW_HH_ */
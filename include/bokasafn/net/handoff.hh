@@ -0,0 +1,180 @@
+/**
+ *  @file handoff.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_HANDOFF_HH_
+#define BOKASAFN_NET_HANDOFF_HH_
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <bokasafn/exceptions.hh>
+#include <bokasafn/net/socket.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief Move live sockets to another process over a unix domain channel
+ *
+ * A front process gives accepted connections to its workers, an old binary gives its listeners
+ * to the new one. The kernel keeps the connections open while in flight, the receiving side
+ * gets them with their pending data and the sending side closes its copies. Each batch carries
+ * a tag for the receiver, a worker index or a listener role for instance. A seqpacket channel
+ * keeps the batches apart, see local::seqpacket::pair().
+ */
+template <typename C>
+class handoff
+{
+  static_assert(C::family == AF_UNIX, "sockets are passed over unix domain sockets");
+
+private:
+  struct header_t
+  {
+    std::uint32_t count;
+    std::uint32_t tag;
+  };
+
+public:
+  explicit handoff(C const & channel) : fd_(channel.fd()), channel_(channel), closed_(false) {}
+
+public:
+  template <typename S>
+  void
+  give(S & s, std::uint32_t tag = 0)
+  {
+    give(&s, 1, tag);
+  }
+
+  /**
+   * @brief Send count sockets to the peer, each one is closed here once sent
+   */
+  template <typename S>
+  void
+  give(S * sockets, std::size_t count, std::uint32_t tag = 0)
+  {
+    int fds[ C::MAX_FDS ];
+
+    while (count)
+    {
+      auto n = std::min(count, C::MAX_FDS);
+
+      for (std::size_t i = 0; i < n; ++i)
+        fds[ i ] = sockets[ i ].fd();
+
+      header_t h{std::uint32_t(n), tag};
+      if (channel_.send_fds(fds, n, &h, sizeof(h)) != ssize_t(sizeof(h)))
+        throw bokasafn::exceptions::perror("sendmsg(SCM_RIGHTS)");
+
+      for (std::size_t i = 0; i < n; ++i)
+        sockets[ i ].close();
+
+      sockets += n;
+      count -= n;
+    }
+  }
+
+  /**
+   * @brief Take one batch from the peer, f(S &&, std::uint32_t tag) per socket
+   *
+   * Descriptors which are not S sockets (SO_DOMAIN, SO_TYPE) are closed.
+   *
+   * @return the number of sockets taken, 0 when nothing was pending or the peer is gone
+   */
+  template <typename S, typename F>
+  std::size_t
+  take(F f)
+  {
+    int fds[ C::MAX_FDS ];
+    std::size_t count = C::MAX_FDS;
+    header_t h{};
+
+    auto n = channel_.recv_fds(fds, count, &h, sizeof(h), MSG_DONTWAIT);
+    if (n < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return 0;
+
+      throw bokasafn::exceptions::perror("recvmsg(SCM_RIGHTS)");
+    }
+
+    if (!n)
+      closed_ = true;
+
+    std::size_t taken = 0;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      if (!is<S>(fds[ i ]))
+      {
+        ::close(fds[ i ]);
+        continue;
+      }
+
+      taken++;
+      f(S(fds[ i ]), h.tag);
+    }
+
+    return taken;
+  }
+
+  /**
+   * @brief Take the batches as they arrive, the channel is removed once the peer is gone
+   */
+  template <typename S, typename E, typename F>
+  void
+  attach(E & e, F f)
+  {
+    e.add(fd_, [this, f](int) {
+      while (take<S>(f))
+        ;
+
+      return !closed_;
+    });
+  }
+
+  /**
+   * @brief The peer closed the channel
+   */
+  bool
+  closed() const
+  {
+    return closed_;
+  }
+
+private:
+  template <typename S>
+  static bool
+  is(int fd)
+  {
+    int domain = 0;
+    int type = 0;
+    socklen_t len = sizeof(int);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &domain, &len) < 0)
+      return false;
+
+    len = sizeof(int);
+    if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) < 0)
+      return false;
+
+    return domain == S::family && type == S::type;
+  }
+
+private:
+  int fd_;
+  C const & channel_;
+  bool closed_;
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_HANDOFF_HH_ */
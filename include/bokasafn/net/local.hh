@@ -0,0 +1,164 @@
+/**
+ *  @file local.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_LOCAL_HH_
+#define BOKASAFN_NET_LOCAL_HH_
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+#include <bokasafn/net/saddr.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+namespace local
+{
+
+/**
+ * @brief Unix domain address, kept apart from saddr so that IP addresses stay small
+ */
+class address
+{
+public:
+  address() : sa_un_{} {}
+
+  /**
+   * @brief In the abstract namespace when path starts with '@'
+   *
+   * Abstract names end at the first NUL. Throws when the path does not fit in sun_path.
+   */
+  explicit address(std::string_view path) : sa_un_{}
+  {
+    if (path.size() >= sizeof(sa_un_.sun_path))
+      detail::invalid_address();
+
+    sa_un_.sun_family = AF_UNIX;
+    std::memcpy(sa_un_.sun_path, path.data(), path.size());
+
+    if (!path.empty() && path[ 0 ] == '@')
+      sa_un_.sun_path[ 0 ] = '\0';
+  }
+
+public:
+  struct sockaddr const *
+  get() const
+  {
+    return sa_un_.sun_family == AF_UNIX ? reinterpret_cast<struct sockaddr const *>(&sa_un_) : nullptr;
+  }
+
+  std::size_t
+  size() const
+  {
+    if (sa_un_.sun_family != AF_UNIX)
+      return 0;
+
+    auto name = path();
+    return offsetof(sockaddr_un, sun_path) + name.size() + (name.empty() || name[ 0 ]);
+  }
+
+  sa_family_t
+  family() const
+  {
+    return sa_un_.sun_family;
+  }
+
+  /**
+   * @brief A NUL first for an abstract name, empty when unnamed
+   */
+  std::string_view
+  path() const
+  {
+    if (sa_un_.sun_family != AF_UNIX)
+      return {};
+
+    auto max = sizeof(sa_un_.sun_path);
+
+    if (sa_un_.sun_path[ 0 ])
+      return {sa_un_.sun_path, strnlen(sa_un_.sun_path, max)};
+
+    auto name = strnlen(sa_un_.sun_path + 1, max - 1);
+    if (!name)
+      return {};
+
+    return {sa_un_.sun_path, name + 1};
+  }
+
+  /**
+   * @brief Clear what the kernel did not write, it writes a unix address only up to its length
+   *
+   * An unnamed peer stays an AF_UNIX address with an empty path.
+   */
+  void
+  received(socklen_t length)
+  {
+    if (length < sizeof(sa_un_))
+      std::memset(reinterpret_cast<char *>(&sa_un_) + length, 0, sizeof(sa_un_) - length);
+
+    sa_un_.sun_family = AF_UNIX;
+  }
+
+  struct sockaddr *
+  raw()
+  {
+    return reinterpret_cast<struct sockaddr *>(&sa_un_);
+  }
+
+  struct sockaddr const *
+  raw() const
+  {
+    return reinterpret_cast<struct sockaddr const *>(&sa_un_);
+  }
+
+private:
+  struct sockaddr_un sa_un_;
+};
+
+template <typename ostream>
+ostream &
+operator<<(ostream & os, address const & a)
+{
+  auto path = a.path();
+  if (!path.empty() && !path[ 0 ])
+    return os << "@" << path.substr(1), os;
+
+  return os << path, os;
+}
+
+inline bool
+operator==(address const & lhs, address const & rhs)
+{
+  return lhs.family() == rhs.family() && lhs.path() == rhs.path();
+}
+
+inline bool
+operator<(address const & lhs, address const & rhs)
+{
+  if (lhs.family() != rhs.family())
+    return lhs.family() < rhs.family();
+
+  return lhs.path() < rhs.path();
+}
+
+} /** !local */
+} /** !net */
+} /** !bokasafn */
+
+template <>
+struct std::hash<bokasafn::net::local::address>
+{
+  std::size_t
+  operator()(bokasafn::net::local::address const & a) const noexcept
+  {
+    return bokasafn::net::detail::mix(std::hash<std::string_view>()(a.path()));
+  }
+};
+
+#endif /** !BOKASAFN_NET_LOCAL_HH_ */
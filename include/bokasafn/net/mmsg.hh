@@ -0,0 +1,150 @@
+/**
+ *  @file mmsg.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_MMSG_HH_
+#define BOKASAFN_NET_MMSG_HH_
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstddef>
+
+#include <bokasafn/net/saddr.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief Batch of up to N datagrams for socket::recvmmsg() and socket::sendmmsg()
+ *
+ * Buffers belong to the caller. Each message has its own address: filled with the source on
+ * receive, used as destination on send unless left unspecified (connected socket).
+ */
+template <std::size_t N>
+class mmsg
+{
+public:
+  static constexpr std::size_t capacity = N;
+
+public:
+  mmsg() : hdrs_{}, iovs_{}, addrs_{}
+  {
+    for (std::size_t i = 0; i < N; ++i)
+    {
+      hdrs_[ i ].msg_hdr.msg_iov = &iovs_[ i ];
+      hdrs_[ i ].msg_hdr.msg_iovlen = 1;
+    }
+  }
+
+  /**
+   * @brief Message i uses the stride bytes at base + i * stride
+   */
+  mmsg(void * base, std::size_t stride) : mmsg()
+  {
+    for (std::size_t i = 0; i < N; ++i)
+      set(i, static_cast<char *>(base) + i * stride, stride);
+  }
+
+  mmsg(mmsg const &) = delete;
+  mmsg &
+  operator=(mmsg const &) = delete;
+
+public:
+  void
+  set(std::size_t i, void const * buffer, std::size_t size)
+  {
+    iovs_[ i ].iov_base = const_cast<void *>(buffer);
+    iovs_[ i ].iov_len = size;
+  }
+
+  void
+  set(std::size_t i, saddr const & to, void const * buffer, std::size_t size)
+  {
+    addrs_[ i ] = to;
+    set(i, buffer, size);
+  }
+
+public:
+  void *
+  data(std::size_t i) const
+  {
+    return iovs_[ i ].iov_base;
+  }
+
+  /**
+   * @brief Bytes received or sent by the last call
+   */
+  std::size_t
+  length(std::size_t i) const
+  {
+    return hdrs_[ i ].msg_len;
+  }
+
+  /**
+   * @brief Message flags of the last receive, e.g. MSG_TRUNC
+   */
+  int
+  flags(std::size_t i) const
+  {
+    return hdrs_[ i ].msg_hdr.msg_flags;
+  }
+
+  saddr &
+  addr(std::size_t i)
+  {
+    return addrs_[ i ];
+  }
+
+  saddr const &
+  addr(std::size_t i) const
+  {
+    return addrs_[ i ];
+  }
+
+public:
+  mmsghdr *
+  prepare_recv(std::size_t count)
+  {
+    for (std::size_t i = 0; i < std::min(count, N); ++i)
+    {
+      auto & h = hdrs_[ i ].msg_hdr;
+
+      h.msg_name = addrs_[ i ].raw();
+      h.msg_namelen = sizeof(saddr);
+      h.msg_flags = 0;
+      hdrs_[ i ].msg_len = 0;
+    }
+
+    return hdrs_;
+  }
+
+  mmsghdr *
+  prepare_send(std::size_t count)
+  {
+    for (std::size_t i = 0; i < std::min(count, N); ++i)
+    {
+      auto & h = hdrs_[ i ].msg_hdr;
+      bool named = addrs_[ i ].family() != PF_UNSPEC;
+
+      h.msg_name = named ? addrs_[ i ].raw() : nullptr;
+      h.msg_namelen = named ? addrs_[ i ].size() : 0;
+      hdrs_[ i ].msg_len = 0;
+    }
+
+    return hdrs_;
+  }
+
+private:
+  mmsghdr hdrs_[ N ];
+  iovec iovs_[ N ];
+  saddr addrs_[ N ];
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_MMSG_HH_ */
@@ -5,6 +5,12 @@
 #ifndef BOKASAFN_NET_MULTICAST_HH_
 #define BOKASAFN_NET_MULTICAST_HH_
 
+#include <net/if.h>
+
+#include <cstring>
+#include <string>
+
+#include <bokasafn/exceptions.hh>
 #include <bokasafn/net/saddr.hh>
 
 namespace bokasafn
@@ -13,23 +19,39 @@ namespace net
 {
 
 /**
- * @brief
+ * @brief Index of a network interface, 0 lets the kernel pick one from the routes
+ */
+inline unsigned
+ifindex(std::string const & name)
+{
+  unsigned i = if_nametoindex(name.c_str());
+  if (!i)
+    throw bokasafn::exceptions::perror("if_nametoindex");
+
+  return i;
+}
+
+/**
+ * @brief Any-source membership of a group on an interface
  */
 class mreq
 {
 public:
-  mreq(saddr const & maddr) : family_(maddr.family())
+  mreq(saddr const & maddr, unsigned ifindex = 0) : family_(maddr.family())
   {
     switch (family_)
     {
       case AF_INET:
         mreq_.imr_multiaddr = maddr.in();
-        mreq_.imr_interface.s_addr = htonT(INADDR_ANY);
+        mreq_.imr_address.s_addr = htonT(INADDR_ANY);
+        mreq_.imr_ifindex = int(ifindex);
         break;
 
       case AF_INET6:
-        // FIXME
+        mreq6_.ipv6mr_multiaddr = maddr.in6();
+        mreq6_.ipv6mr_interface = ifindex;
         break;
+
       default:
         break;
     }
@@ -67,11 +89,45 @@ public:
 private:
   sa_family_t family_;
   union {
-    struct ip_mreq mreq_;
+    struct ip_mreqn mreq_;
     struct ipv6_mreq mreq6_;
   };
 };
 
+/**
+ * @brief Source-specific membership (SSM), only source's traffic to the group is received
+ *
+ * Protocol independent (MCAST_JOIN_SOURCE_GROUP), the level follows the socket family.
+ */
+class mreq_source
+{
+public:
+  mreq_source(saddr const & maddr, saddr const & source, unsigned ifindex = 0)
+  {
+    std::memset(&req_, 0, sizeof(req_));
+
+    req_.gsr_interface = ifindex;
+    std::memcpy(&req_.gsr_group, maddr.get(), maddr.size());
+    std::memcpy(&req_.gsr_source, source.get(), source.size());
+  }
+
+public:
+  constexpr void const *
+  raw() const
+  {
+    return &req_;
+  }
+
+  constexpr size_t
+  size() const
+  {
+    return sizeof(req_);
+  }
+
+private:
+  struct group_source_req req_;
+};
+
 } /** !net */
 } /** !bokasafn */
 
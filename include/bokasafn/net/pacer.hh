@@ -0,0 +1,376 @@
+/**
+ *  @file pacer.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_PACER_HH_
+#define BOKASAFN_NET_PACER_HH_
+
+#include <linux/net_tstamp.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <bokasafn/exceptions.hh>
+#include <bokasafn/net/saddr.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief Token bucket paced datagram sender
+ *
+ * Datagrams go out right away while the bucket holds enough bytes, the others are queued and
+ * sent from a loop timer armed for when the bucket has refilled enough. A datagram larger
+ * than the burst leaves once the bucket is full.
+ *
+ * With txtime() the datagrams the bucket lets through are also stamped with their departure
+ * time (SO_TXTIME), so that an fq or etf qdisc on the egress interface spreads a burst too.
+ * Any other qdisc ignores the stamps and the bucket alone paces. max_pacing_rate() caps the
+ * socket in the fq qdisc as well.
+ */
+template <typename S>
+class pacer
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct config_t
+  {
+    /**
+     * @brief Bytes per second
+     */
+    std::uint64_t rate;
+
+    /**
+     * @brief Bytes sent back to back at most
+     */
+    std::size_t burst = 64 * 1024;
+
+    /**
+     * @brief Bytes queued at most, send() refuses beyond
+     */
+    std::size_t backlog = 16 << 20;
+  };
+
+private:
+  struct entry_t
+  {
+    saddr to;
+    std::size_t offset;
+    std::size_t size;
+  };
+
+public:
+  pacer(S const & s, config_t const & config)
+    : fd_(s.fd()), timer_(-1), config_(config), tokens_(double(config.burst)), last_(clock::now()),
+      next_(last_), txtime_(false), queued_(0), base_(0), armed_(false)
+  {
+  }
+
+  ~pacer()
+  {
+    if (detach_)
+      detach_();
+
+    if (timer_ >= 0)
+      ::close(timer_);
+  }
+
+  pacer(pacer const &) = delete;
+  pacer &
+  operator=(pacer const &) = delete;
+
+public:
+  /**
+   * @brief Send now if the bucket allows it, queue the datagram otherwise
+   *
+   * @return false when the backlog is full, or when sending failed
+   */
+  bool
+  send(void const * buffer, std::size_t size, saddr const & to = {})
+  {
+    if (queue_.empty())
+    {
+      refill(clock::now());
+
+      if (allowed(size))
+      {
+        auto n = transmit(buffer, size, to);
+        if (n >= 0)
+        {
+          tokens_ -= double(size);
+          return true;
+        }
+
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+          return false;
+      }
+    }
+
+    if (queued_ + size > config_.backlog)
+      return false;
+
+    queue_.push_back({to, base_ + bytes_.size(), size});
+    bytes_.insert(bytes_.end(), static_cast<char const *>(buffer), static_cast<char const *>(buffer) + size);
+    queued_ += size;
+
+    arm();
+
+    return true;
+  }
+
+  /**
+   * @brief Send what the bucket allows from the queue
+   *
+   * @return the time until the next queued datagram may leave, zero when the queue is empty
+   */
+  clock::duration
+  flush(clock::time_point now = clock::now())
+  {
+    refill(now);
+
+    while (!queue_.empty())
+    {
+      auto & e = queue_.front();
+
+      if (!allowed(e.size))
+        return wait(e.size);
+
+      auto n = transmit(bytes_.data() + (e.offset - base_), e.size, e.to);
+      if (n < 0)
+      {
+        // Full socket buffer, try again a little later. Other errors drop the datagram.
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+          return std::chrono::microseconds(100);
+      }
+
+      tokens_ -= double(e.size);
+      queued_ -= e.size;
+      queue_.pop_front();
+
+      compact();
+    }
+
+    return clock::duration::zero();
+  }
+
+  /**
+   * @brief Drive the queue from a timer of the loop, which must outlive the pacer
+   */
+  template <typename E>
+  void
+  attach(E & e)
+  {
+    timer_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_ < 0)
+      throw bokasafn::exceptions::perror("timerfd_create");
+
+    e.add(timer_, [this](int fd) {
+      std::uint64_t expirations;
+      if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        throw bokasafn::exceptions::perror("timer_read");
+
+      armed_ = false;
+      arm();
+
+      return true;
+    });
+
+    detach_ = [&e, fd = timer_]() { e.remove(fd); };
+  }
+
+public:
+  /**
+   * @brief Cap the socket rate in the fq qdisc (SO_MAX_PACING_RATE), on top of the bucket
+   *
+   * @return false when the kernel refused
+   */
+  bool
+  max_pacing_rate()
+  {
+    std::uint64_t rate = config_.rate;
+
+    return !setsockopt(fd_, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate));
+  }
+
+  /**
+   * @brief Stamp the datagrams with their departure time as well (SO_TXTIME)
+   *
+   * The kernel accepts the option whatever the qdisc, true does not mean the stamps are
+   * enforced. The bucket keeps pacing either way.
+   *
+   * @return false when the kernel refused the option
+   */
+  bool
+  txtime()
+  {
+#ifdef SO_TXTIME
+    sock_txtime config{CLOCK_MONOTONIC, 0};
+
+    txtime_ = !setsockopt(fd_, SOL_SOCKET, SO_TXTIME, &config, sizeof(config));
+#endif
+
+    return txtime_;
+  }
+
+public:
+  std::size_t
+  queued() const
+  {
+    return queued_;
+  }
+
+  std::size_t
+  pending() const
+  {
+    return queue_.size();
+  }
+
+private:
+  void
+  refill(clock::time_point now)
+  {
+    auto elapsed = std::chrono::duration<double>(now - last_).count();
+    last_ = now;
+
+    if (elapsed > 0)
+      tokens_ = std::min(double(config_.burst), tokens_ + elapsed * double(config_.rate));
+  }
+
+  bool
+  allowed(std::size_t size) const
+  {
+    return tokens_ >= double(std::min(size, config_.burst));
+  }
+
+  clock::duration
+  wait(std::size_t size) const
+  {
+    auto missing = double(std::min(size, config_.burst)) - tokens_;
+
+    return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(missing / double(config_.rate))) +
+           clock::duration(1);
+  }
+
+  /**
+   * @brief Flush, then arm the timer for the next datagram when some are left
+   */
+  void
+  arm()
+  {
+    if (armed_ || timer_ < 0)
+      return;
+
+    auto delay = flush();
+    if (delay == clock::duration::zero())
+      return;
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count();
+    itimerspec ts{{0, 0}, {ns / 1000000000, ns % 1000000000}};
+
+    if (timerfd_settime(timer_, 0, &ts, nullptr) < 0)
+      throw bokasafn::exceptions::perror("timer_settime");
+
+    armed_ = true;
+  }
+
+  void
+  compact()
+  {
+    if (queue_.empty())
+    {
+      bytes_.clear();
+      base_ = 0;
+      return;
+    }
+
+    auto head = queue_.front().offset - base_;
+    if (head > 1 << 20 && head > bytes_.size() / 2)
+    {
+      bytes_.erase(bytes_.begin(), bytes_.begin() + std::ptrdiff_t(head));
+      base_ += head;
+    }
+  }
+
+  ssize_t
+  transmit(void const * buffer, std::size_t size, saddr const & to)
+  {
+    if (txtime_)
+      return stamp(buffer, size, to);
+
+    return ::sendto(fd_, buffer, size, MSG_DONTWAIT, to.get(), to.size());
+  }
+
+  ssize_t
+  stamp(void const * buffer, std::size_t size, saddr const & to)
+  {
+#ifdef SO_TXTIME
+    auto now = clock::now();
+    next_ = std::max(next_, now - std::chrono::duration_cast<clock::duration>(
+                                    std::chrono::duration<double>(double(config_.burst) / double(config_.rate))));
+
+    std::uint64_t departure = std::uint64_t(std::chrono::nanoseconds(std::max(next_, now).time_since_epoch()).count());
+    next_ += std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(double(size) / double(config_.rate)));
+
+    iovec iov{const_cast<void *>(buffer), size};
+    alignas(cmsghdr) char control[ CMSG_SPACE(sizeof(departure)) ] = {};
+
+    msghdr msg{};
+    msg.msg_name = const_cast<sockaddr *>(to.get());
+    msg.msg_namelen = socklen_t(to.size());
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    auto c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_TXTIME;
+    c->cmsg_len = CMSG_LEN(sizeof(departure));
+    std::memcpy(CMSG_DATA(c), &departure, sizeof(departure));
+
+    return ::sendmsg(fd_, &msg, MSG_DONTWAIT);
+#else
+    (void)buffer;
+    (void)size;
+    (void)to;
+
+    errno = ENOPROTOOPT;
+    return -1;
+#endif
+  }
+
+private:
+  int fd_;
+  int timer_;
+  config_t config_;
+
+  double tokens_;
+  clock::time_point last_;
+  clock::time_point next_;
+  bool txtime_;
+
+  std::deque<entry_t> queue_;
+  std::vector<char> bytes_;
+  std::size_t queued_;
+  std::size_t base_;
+  bool armed_;
+
+  std::function<void()> detach_;
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_PACER_HH_ */
@@ -0,0 +1,207 @@
+/**
+ *  @file packet.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_PACKET_HH_
+#define BOKASAFN_NET_PACKET_HH_
+
+#include <endian.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <bokasafn/exceptions.hh>
+#include <bokasafn/net/socket.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+namespace packet
+{
+
+/**
+ * @brief Every ethertype, in network order as socket(2) wants it
+ */
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+constexpr int ALL = ((ETH_P_ALL & 0xff) << 8) | (ETH_P_ALL >> 8);
+#else
+constexpr int ALL = ETH_P_ALL;
+#endif
+
+using raw = socket<AF_PACKET, SOCK_RAW, ALL>;
+
+/**
+ * @brief A frame in the ring, valid until the poll() callback returns
+ */
+struct frame
+{
+  void const * data;
+  std::size_t size;
+  std::size_t wire;
+  std::chrono::system_clock::time_point at;
+
+  /**
+   * @brief PACKET_HOST, PACKET_OUTGOING... loopback shows every packet twice
+   */
+  unsigned char type;
+};
+
+/**
+ * @brief TPACKET_V3 receive ring mapped over an AF_PACKET socket
+ *
+ * The kernel fills blocks of frames and hands a block over once full or once its timeout
+ * expired. poll() walks the blocks owned by user space and gives them back, without a syscall
+ * per frame. The socket is readable whenever a block is ready.
+ */
+class rx_ring
+{
+public:
+  struct config_t
+  {
+    unsigned block_size = 1 << 22;
+    unsigned blocks = 64;
+    unsigned frame_size = 2048;
+    unsigned timeout_ms = 10;
+  };
+
+public:
+  rx_ring(raw const & s, config_t const & config) : fd_(s.fd()), config_(config), current_(0)
+  {
+    s.set_option(option<SOL_PACKET, PACKET_VERSION, int>(TPACKET_V3));
+
+    tpacket_req3 req{};
+    req.tp_block_size = config_.block_size;
+    req.tp_block_nr = config_.blocks;
+    req.tp_frame_size = config_.frame_size;
+    req.tp_frame_nr = config_.block_size / config_.frame_size * config_.blocks;
+    req.tp_retire_blk_tov = config_.timeout_ms;
+
+    s.set_option(option<SOL_PACKET, PACKET_RX_RING, tpacket_req3>(req));
+
+    size_ = std::size_t(config_.block_size) * config_.blocks;
+
+    auto map = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED | MAP_POPULATE, fd_, 0);
+    if (map == MAP_FAILED)
+      map = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, 0);
+    if (map == MAP_FAILED)
+      throw bokasafn::exceptions::perror("mmap");
+
+    map_ = static_cast<std::uint8_t *>(map);
+  }
+
+  rx_ring(raw const & s) : rx_ring(s, config_t{}) {}
+
+  ~rx_ring() { munmap(map_, size_); }
+
+  rx_ring(rx_ring const &) = delete;
+  rx_ring &
+  operator=(rx_ring const &) = delete;
+
+public:
+  /**
+   * @brief Capture on one interface only, every interface when not called
+   */
+  void
+  bind(unsigned ifindex) const
+  {
+    sockaddr_ll ll{};
+    ll.sll_family = AF_PACKET;
+    ll.sll_protocol = ALL;
+    ll.sll_ifindex = int(ifindex);
+
+    if (::bind(fd_, reinterpret_cast<sockaddr *>(&ll), sizeof(ll)) < 0)
+      throw bokasafn::exceptions::perror("bind");
+  }
+
+  /**
+   * @brief Share the traffic with the other sockets of group, one per worker
+   *
+   * @param type PACKET_FANOUT_HASH keeps flows together, PACKET_FANOUT_CPU follows the
+   *             receiving CPU
+   */
+  void
+  fanout(std::uint16_t group, int type = PACKET_FANOUT_HASH) const
+  {
+    int arg = group | (type << 16);
+
+    if (setsockopt(fd_, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0)
+      throw bokasafn::exceptions::perror("setsockopt(PACKET_FANOUT)");
+  }
+
+  /**
+   * @brief Call f(frame const &) on every frame of the ready blocks
+   *
+   * @return the number of frames
+   */
+  template <typename F>
+  std::size_t
+  poll(F f)
+  {
+    std::size_t n = 0;
+
+    for (;;)
+    {
+      auto block = reinterpret_cast<tpacket_block_desc *>(map_ + std::size_t(current_) * config_.block_size);
+      auto & bh = block->hdr.bh1;
+
+      if (!(__atomic_load_n(&bh.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+        return n;
+
+      auto hdr = reinterpret_cast<tpacket3_hdr const *>(reinterpret_cast<std::uint8_t *>(block) +
+                                                        bh.offset_to_first_pkt);
+
+      for (std::uint32_t i = 0; i < bh.num_pkts; ++i)
+      {
+        frame fr{reinterpret_cast<std::uint8_t const *>(hdr) + hdr->tp_mac,
+                 hdr->tp_snaplen,
+                 hdr->tp_len,
+                 std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                   std::chrono::seconds(hdr->tp_sec) + std::chrono::nanoseconds(hdr->tp_nsec))),
+                 reinterpret_cast<sockaddr_ll const *>(reinterpret_cast<std::uint8_t const *>(hdr) +
+                                                       TPACKET_ALIGN(sizeof(tpacket3_hdr)))
+                   ->sll_pkttype};
+
+        f(fr);
+        n++;
+
+        hdr = reinterpret_cast<tpacket3_hdr const *>(reinterpret_cast<std::uint8_t const *>(hdr) + hdr->tp_next_offset);
+      }
+
+      __atomic_store_n(&bh.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+      current_ = (current_ + 1) % config_.blocks;
+    }
+  }
+
+  /**
+   * @brief Walk the ring each time the loop reports a block ready
+   */
+  template <typename E, typename F>
+  void
+  attach(E & e, F f)
+  {
+    e.add(fd_, [this, f](int) {
+      poll(f);
+      return true;
+    });
+  }
+
+private:
+  int fd_;
+  config_t config_;
+
+  std::uint8_t * map_;
+  std::size_t size_;
+  unsigned current_;
+};
+
+} /** !packet */
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_PACKET_HH_ */
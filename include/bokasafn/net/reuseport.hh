@@ -0,0 +1,141 @@
+/**
+ *  @file reuseport.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_REUSEPORT_HH_
+#define BOKASAFN_NET_REUSEPORT_HH_
+
+#include <linux/filter.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <bokasafn/exceptions.hh>
+#include <bokasafn/net/saddr.hh>
+#include <bokasafn/net/socket.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief N sockets bound to the same address with SO_REUSEPORT, one per worker
+ *
+ * Socket i is meant to be served by worker i, pinned to CPU i modulo the CPU count. Stream
+ * sockets are listening once constructed.
+ */
+template <typename S>
+class listener_group
+{
+public:
+  listener_group(saddr const & a, std::size_t n, int backlog = 128)
+  {
+    auto cpus = std::max(1u, std::thread::hardware_concurrency());
+
+    sockets_.reserve(n);
+
+    // The kernel numbers the group sockets in bind (listen for TCP) order
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      auto & s = sockets_.emplace_back();
+
+      s.set_option(option<SOL_SOCKET, SO_REUSEPORT, int>(true));
+
+      // Also a hint for the default selection, before any program is attached
+      int cpu = int(i % cpus);
+      setsockopt(s.fd(), SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
+
+      s.bind(a);
+
+      if constexpr (S::type == SOCK_STREAM)
+        s.listen(backlog);
+    }
+  }
+
+  ~listener_group()
+  {
+    join();
+  }
+
+  listener_group(listener_group const &) = delete;
+  listener_group &
+  operator=(listener_group const &) = delete;
+
+public:
+  /**
+   * @brief Steer every packet or connection to socket (receiving CPU modulo N)
+   *
+   * With one socket per CPU, a flow stays on the CPU its interrupts land on.
+   */
+  void
+  steer_by_cpu() const
+  {
+    sock_filter code[] = {
+      {BPF_LD | BPF_W | BPF_ABS, 0, 0, std::uint32_t(SKF_AD_OFF + SKF_AD_CPU)},
+      {BPF_ALU | BPF_MOD | BPF_K, 0, 0, std::uint32_t(sockets_.size())},
+      {BPF_RET | BPF_A, 0, 0, 0},
+    };
+
+    sock_fprog prog{sizeof(code) / sizeof(code[ 0 ]), code};
+
+    sockets_.front().set_option(option<SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, sock_fprog>(prog));
+  }
+
+  /**
+   * @brief Start one thread per socket, pinned to its CPU, running f(i, socket)
+   */
+  template <typename F>
+  void
+  start(F f)
+  {
+    auto cpus = std::max(1u, std::thread::hardware_concurrency());
+
+    for (std::size_t i = 0; i < sockets_.size(); ++i)
+    {
+      workers_.emplace_back([this, f, i, cpus]() {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(i % cpus, &set);
+
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+        f(i, sockets_[ i ]);
+      });
+    }
+  }
+
+  void
+  join()
+  {
+    for (auto & w : workers_)
+      w.join();
+
+    workers_.clear();
+  }
+
+public:
+  S &
+  operator[](std::size_t i)
+  {
+    return sockets_[ i ];
+  }
+
+  std::size_t
+  size() const
+  {
+    return sockets_.size();
+  }
+
+private:
+  std::vector<S> sockets_;
+  std::vector<std::thread> workers_;
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_REUSEPORT_HH_ */
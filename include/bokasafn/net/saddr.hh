@@ -7,11 +7,14 @@
 
 #include <arpa/inet.h>
 #include <endian.h> // __BYTE_ORDER __LITTLE_ENDIAN
-#include <netdb.h>
 #include <sys/socket.h>
 
-#include <algorithm> // std::reverse()
-#include <string>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <type_traits>
 
 #include <bokasafn/exceptions.hh>
 
@@ -25,10 +28,18 @@ constexpr T
 htonT(T value) noexcept
 {
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-  char * ptr = reinterpret_cast<char *>(&value);
-  std::reverse(ptr, ptr + sizeof(T));
-#endif
+  using U = std::make_unsigned_t<T>;
+
+  U in = static_cast<U>(value);
+  U out = 0;
+
+  for (std::size_t i = 0; i < sizeof(T); ++i, in >>= 8)
+    out = static_cast<U>((out << 8) | (in & 0xff));
+
+  return static_cast<T>(out);
+#else
   return value;
+#endif
 }
 
 template <typename T>
@@ -38,6 +49,166 @@ ntohT(T value) noexcept
   return htonT(value);
 }
 
+namespace detail
+{
+
+/**
+ * @brief Decimal number of at most max, without sign nor leading zero
+ */
+constexpr std::optional<std::uint32_t>
+parse_decimal(std::string_view s, std::uint32_t max)
+{
+  if (s.empty() || s.size() > 10 || (s.size() > 1 && s[ 0 ] == '0'))
+    return std::nullopt;
+
+  std::uint64_t v = 0;
+
+  for (char c : s)
+  {
+    if (c < '0' || c > '9')
+      return std::nullopt;
+
+    v = v * 10 + std::uint64_t(c - '0');
+  }
+
+  if (v > max)
+    return std::nullopt;
+
+  return std::uint32_t(v);
+}
+
+constexpr std::optional<std::uint16_t>
+parse_port(std::string_view s)
+{
+  auto v = parse_decimal(s, 0xffff);
+  if (!v)
+    return std::nullopt;
+
+  return std::uint16_t(*v);
+}
+
+/**
+ * @brief Dotted quad, as accepted by inet_pton
+ */
+constexpr std::optional<in_addr>
+parse_in(std::string_view s)
+{
+  std::uint32_t addr = 0;
+
+  for (int i = 0; i < 4; ++i)
+  {
+    auto dot = i < 3 ? s.find('.') : s.size();
+    if (dot == std::string_view::npos || (i == 3 && s.find('.') != std::string_view::npos))
+      return std::nullopt;
+
+    auto octet = parse_decimal(s.substr(0, dot), 255);
+    if (!octet)
+      return std::nullopt;
+
+    addr = (addr << 8) | *octet;
+    s.remove_prefix(i < 3 ? dot + 1 : dot);
+  }
+
+  return in_addr{htonT(addr)};
+}
+
+/**
+ * @brief RFC 4291 text form: 8 groups, one "::" at most, optionally ending with a dotted quad
+ */
+constexpr std::optional<in6_addr>
+parse_in6(std::string_view s)
+{
+  std::uint16_t groups[ 8 ] = {};
+  int n = 0;
+  int gap = -1;
+
+  if (s.size() >= 2 && s[ 0 ] == ':' && s[ 1 ] == ':')
+  {
+    gap = 0;
+    s.remove_prefix(2);
+  }
+
+  while (!s.empty())
+  {
+    auto end = s.find(':');
+    auto group = s.substr(0, end);
+
+    if (group.find('.') != std::string_view::npos)
+    {
+      auto v4 = end == std::string_view::npos && n <= 6 ? parse_in(group) : std::nullopt;
+      if (!v4)
+        return std::nullopt;
+
+      auto v = ntohT(v4->s_addr);
+      groups[ n++ ] = std::uint16_t(v >> 16);
+      groups[ n++ ] = std::uint16_t(v);
+      break;
+    }
+
+    if (group.empty() || group.size() > 4 || n == 8)
+      return std::nullopt;
+
+    std::uint16_t v = 0;
+    for (char c : group)
+    {
+      int digit = c >= '0' && c <= '9'   ? c - '0'
+                  : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                  : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                         : -1;
+      if (digit < 0)
+        return std::nullopt;
+
+      v = std::uint16_t(v << 4 | digit);
+    }
+    groups[ n++ ] = v;
+
+    if (end == std::string_view::npos)
+      break;
+
+    s.remove_prefix(end + 1);
+
+    if (!s.empty() && s[ 0 ] == ':')
+    {
+      if (gap >= 0)
+        return std::nullopt;
+
+      gap = n;
+      s.remove_prefix(1);
+    }
+    else if (s.empty())
+      return std::nullopt;
+  }
+
+  if (gap < 0 ? n != 8 : n > 7)
+    return std::nullopt;
+
+  in6_addr addr{};
+
+  for (int i = 0, j = 0; i < 8; ++i)
+  {
+    std::uint16_t v = 0;
+
+    if (gap < 0 || i < gap)
+      v = groups[ j++ ];
+    else if (i >= gap + 8 - n)
+      v = groups[ j++ ];
+
+    addr.s6_addr[ 2 * i ] = std::uint8_t(v >> 8);
+    addr.s6_addr[ 2 * i + 1 ] = std::uint8_t(v);
+  }
+
+  return addr;
+}
+
+[[noreturn]] inline void
+invalid_address()
+{
+  errno = EINVAL;
+  throw bokasafn::exceptions::perror("saddr");
+}
+
+} /** !detail */
+
 class saddr
 {
 public:
@@ -52,43 +223,72 @@ public:
   {
   }
   constexpr saddr(struct in6_addr const & in, std::uint16_t port)
-    : sa_in6_({AF_INET6, 0, htonT(port), in, 0})
+    : sa_in6_({AF_INET6, htonT(port), 0, in, 0})
   {
   }
 
-  saddr(std::string const & str, std::uint16_t port)
-  {
-    struct addrinfo hint = {};
-    struct addrinfo * info = nullptr;
+  /**
+   * @brief Numeric IPv4 or IPv6 address, throws on anything else
+   */
+  constexpr saddr(std::string_view str, std::uint16_t port) : saddr(make(str, port, true)) {}
 
-    hint.ai_family = PF_UNSPEC;
-    hint.ai_flags = AI_NUMERICHOST;
+  /**
+   * @brief Parse "a.b.c.d:port", "[v6]:port" or a bare address with port 0
+   *
+   * @return a PF_UNSPEC address when invalid
+   */
+  static constexpr saddr
+  parse(std::string_view endpoint)
+  {
+    std::uint16_t port = 0;
 
-    if (getaddrinfo(str.c_str(), nullptr, &hint, &info))
-      throw bokasafn::exceptions::perror("getaddrinfo");
+    if (!endpoint.empty() && endpoint[ 0 ] == '[')
+    {
+      auto close = endpoint.find(']');
+      if (close == std::string_view::npos)
+        return {};
 
-    sa_raw_.sa_family = info->ai_family;
+      auto rest = endpoint.substr(close + 1);
+      if (!rest.empty())
+      {
+        auto p = rest[ 0 ] == ':' ? detail::parse_port(rest.substr(1)) : std::nullopt;
+        if (!p)
+          return {};
+        port = *p;
+      }
 
-    freeaddrinfo(info);
+      auto in6 = detail::parse_in6(endpoint.substr(1, close - 1));
+      return in6 ? saddr(*in6, port) : saddr();
+    }
 
-    switch (sa_raw_.sa_family)
+    auto colon = endpoint.find(':');
+    if (colon != std::string_view::npos && endpoint.find(':', colon + 1) == std::string_view::npos)
     {
-      case AF_INET:
-        sa_in_.sin_family = AF_INET;
-        sa_in_.sin_port = htonT(port);
-        inet_pton(sa_raw_.sa_family, str.c_str(), &sa_in_.sin_addr);
-        break;
+      auto p = detail::parse_port(endpoint.substr(colon + 1));
+      if (!p)
+        return {};
 
-      case AF_INET6:
-        sa_in6_.sin6_family = AF_INET6;
-        sa_in6_.sin6_port = htonT(port);
-        inet_pton(sa_raw_.sa_family, str.c_str(), &sa_in6_.sin6_addr);
-        break;
-
-      default:
-        sa_raw_.sa_family = PF_UNSPEC;
-        break;
+      port = *p;
+      endpoint = endpoint.substr(0, colon);
     }
+
+    return make(endpoint, port);
+  }
+
+private:
+  static constexpr saddr
+  make(std::string_view str, std::uint16_t port, bool required = false)
+  {
+    if (auto in = detail::parse_in(str))
+      return saddr(*in, port);
+
+    if (auto in6 = detail::parse_in6(str))
+      return saddr(*in6, port);
+
+    if (required)
+      detail::invalid_address();
+
+    return {};
   }
 
 public:
@@ -161,6 +361,12 @@ public:
     return sa_in_.sin_addr;
   }
 
+  constexpr in6_addr
+  in6() const
+  {
+    return sa_in6_.sin6_addr;
+  }
+
   constexpr struct sockaddr *
   raw()
   {
@@ -192,13 +398,114 @@ operator<<(ostream & os, saddr const & a)
   return os << buffer << ":" << a.port(), os;
 }
 
-bool
+/**
+ * @brief Same family, address and port, plus the scope for IPv6
+ */
+inline bool
+operator==(saddr const & lhs, saddr const & rhs)
+{
+  if (lhs.family() != rhs.family() || lhs.port() != rhs.port())
+    return false;
+
+  switch (lhs.family())
+  {
+    case AF_INET:
+      return lhs.in().s_addr == rhs.in().s_addr;
+    case AF_INET6:
+    {
+      auto const & l = *reinterpret_cast<sockaddr_in6 const *>(lhs.raw());
+      auto const & r = *reinterpret_cast<sockaddr_in6 const *>(rhs.raw());
+
+      return !std::memcmp(&l.sin6_addr, &r.sin6_addr, sizeof(in6_addr)) && l.sin6_scope_id == r.sin6_scope_id;
+    }
+    default:
+      return true;
+  }
+}
+
+/**
+ * @brief Order by family, then address in network order, then scope for IPv6, then port
+ */
+inline bool
 operator<(saddr const & lhs, saddr const & rhs)
 {
-  return memcmp(lhs.raw(), rhs.raw(), sizeof(struct sockaddr)) < 0;
+  if (lhs.family() != rhs.family())
+    return lhs.family() < rhs.family();
+
+  int cmp = 0;
+
+  switch (lhs.family())
+  {
+    case AF_INET:
+      cmp = std::memcmp(lhs.in_raw(), rhs.in_raw(), sizeof(in_addr));
+      break;
+    case AF_INET6:
+    {
+      auto const & l = *reinterpret_cast<sockaddr_in6 const *>(lhs.raw());
+      auto const & r = *reinterpret_cast<sockaddr_in6 const *>(rhs.raw());
+
+      cmp = std::memcmp(&l.sin6_addr, &r.sin6_addr, sizeof(in6_addr));
+      if (!cmp && l.sin6_scope_id != r.sin6_scope_id)
+        return l.sin6_scope_id < r.sin6_scope_id;
+      break;
+    }
+    default:
+      return false;
+  }
+
+  return cmp ? cmp < 0 : lhs.port() < rhs.port();
+}
+
+namespace detail
+{
+
+/**
+ * @brief Finalizer of splitmix64, every input bit flips about half of the output bits
+ */
+constexpr std::uint64_t
+mix(std::uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+
+  return x;
 }
 
+} /** !detail */
+
 } /** !net */
 } /** !bokasafn */
 
+template <>
+struct std::hash<bokasafn::net::saddr>
+{
+  std::size_t
+  operator()(bokasafn::net::saddr const & a) const noexcept
+  {
+    using bokasafn::net::detail::mix;
+
+    std::uint64_t key = (std::uint64_t(a.family()) << 16) | a.port();
+
+    switch (a.family())
+    {
+      case AF_INET:
+        return mix(key << 32 | a.in().s_addr);
+
+      case AF_INET6:
+      {
+        std::uint64_t words[ 2 ];
+        std::memcpy(words, a.in_raw(), sizeof(words));
+
+        return mix(mix(key ^ words[ 0 ]) ^ words[ 1 ]);
+      }
+
+      default:
+        return mix(key);
+    }
+  }
+};
+
 #endif /** !BOKASAFN_NET_SADDR_HH_ */
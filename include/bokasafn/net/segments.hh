@@ -0,0 +1,129 @@
+/**
+ *  @file segments.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_SEGMENTS_HH_
+#define BOKASAFN_NET_SEGMENTS_HH_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <span>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief View of the datagrams coalesced in a UDP GRO buffer
+ *
+ * Every segment is segment() bytes long but the last one, which may be shorter.
+ */
+class segments
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::span<char const>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+  public:
+    iterator() = default;
+    iterator(char const * at, char const * end, std::size_t segment) : at_(at), end_(end), segment_(segment) {}
+
+  public:
+    value_type
+    operator*() const
+    {
+      return {at_, std::min<std::size_t>(segment_, end_ - at_)};
+    }
+
+    iterator &
+    operator++()
+    {
+      at_ += std::min<std::size_t>(segment_, end_ - at_);
+      return *this;
+    }
+
+    iterator
+    operator++(int)
+    {
+      auto it = *this;
+      ++*this;
+      return it;
+    }
+
+    bool
+    operator==(iterator const & other) const
+    {
+      return at_ == other.at_;
+    }
+
+  private:
+    char const * at_ = nullptr;
+    char const * end_ = nullptr;
+    std::size_t segment_ = 0;
+  };
+
+public:
+  segments() = default;
+  segments(void const * data, std::size_t size, std::size_t segment)
+    : data_(static_cast<char const *>(data)), size_(size), segment_(segment ? segment : size)
+  {
+  }
+
+public:
+  iterator
+  begin() const
+  {
+    return {data_, data_ + size_, segment_};
+  }
+
+  iterator
+  end() const
+  {
+    return {data_ + size_, data_ + size_, segment_};
+  }
+
+  /**
+   * @brief Size of every segment but the last, the whole buffer when nothing was coalesced
+   */
+  std::size_t
+  segment() const
+  {
+    return segment_;
+  }
+
+  std::size_t
+  count() const
+  {
+    return segment_ ? (size_ + segment_ - 1) / segment_ : 0;
+  }
+
+  std::size_t
+  size() const
+  {
+    return size_;
+  }
+
+  void const *
+  data() const
+  {
+    return data_;
+  }
+
+private:
+  char const * data_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t segment_ = 0;
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_SEGMENTS_HH_ */
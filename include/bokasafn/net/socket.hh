@@ -8,14 +8,27 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
-#include <memory>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
 
 #include <bokasafn/exceptions.hh>
+#include <bokasafn/net/chain.hh>
+#include <bokasafn/net/local.hh>
+#include <bokasafn/net/mmsg.hh>
 #include <bokasafn/net/multicast.hh>
 #include <bokasafn/net/saddr.hh>
+#include <bokasafn/net/segments.hh>
+#include <bokasafn/net/timestamp.hh>
 
 namespace bokasafn
 {
@@ -75,22 +88,97 @@ public:
   option(mreq const & v) : value_(v), optlen(value_.size()), optval(value_.raw()) {}
 };
 
+template <int L, int O>
+class option<L, O, mreq_source>
+{
+private:
+  mreq_source value_;
+
+public:
+  constexpr static int level = L;
+  constexpr static int optname = O;
+  socklen_t optlen;
+  void const * optval;
+
+  option(mreq_source const & v) : value_(v), optlen(value_.size()), optval(value_.raw()) {}
+};
+
+/**
+ * @brief UDP GSO, datagrams sent are split by the kernel into segments of this size
+ */
+using udp_segment = option<SOL_UDP, UDP_SEGMENT, int>;
+
+/**
+ * @brief UDP GRO, the socket accepts coalesced datagrams, see socket::recv_gro()
+ */
+using udp_gro = option<SOL_UDP, UDP_GRO, int>;
+
+/**
+ * @brief Receive timestamps as SCM_TIMESTAMPNS, see socket::recv_timestamped()
+ */
+using so_timestampns = option<SOL_SOCKET, SO_TIMESTAMPNS, int>;
+
+/**
+ * @brief SOF_TIMESTAMPING_* flags, e.g. RX_SOFTWARE | TX_SOFTWARE | SOFTWARE | OPT_ID
+ */
+using so_timestamping = option<SOL_SOCKET, SO_TIMESTAMPING, int>;
+
+/**
+ * @brief Hold partial TCP frames until uncorked, see net::cork
+ */
+using tcp_cork = option<IPPROTO_TCP, TCP_CORK, int>;
+
 /**
  * @brief
  */
 template <int AF, int SOCK, int PROTO>
 class socket
 {
+public:
+  constexpr static int family = AF;
+  constexpr static int type = SOCK;
+  constexpr static int protocol = PROTO;
+
+  /**
+   * @brief Address of the family, local::address for unix domain sockets
+   */
+  using address = std::conditional_t<AF == AF_UNIX, local::address, saddr>;
+
+  /**
+   * @brief Descriptors in one SCM_RIGHTS message (SCM_MAX_FD)
+   */
+  constexpr static std::size_t MAX_FDS = 253;
+
 public:
   socket() { fd_ = ::socket(AF, SOCK, PROTO); }
   ~socket() { close(); }
 
-private:
-  socket(int fd) : fd_(fd) {}
+  /**
+   * @brief Own an already open descriptor
+   */
+  explicit socket(int fd) : fd_(fd) {}
+
+  socket(socket && other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+  socket(socket const &) = delete;
+
+  socket &
+  operator=(socket && other) noexcept
+  {
+    if (this != &other)
+    {
+      close();
+      fd_ = std::exchange(other.fd_, -1);
+    }
+
+    return *this;
+  }
+
+  socket &
+  operator=(socket const &) = delete;
 
 public:
   void
-  bind(saddr const & a) const
+  bind(address const & a) const
   {
     // bind to receive address
     if (::bind(fd_, a.get(), a.size()) < 0)
@@ -98,7 +186,7 @@ public:
   }
 
   void
-  connect(saddr const & a) const
+  connect(address const & a) const
   {
     if (::connect(fd_, a.get(), a.size()) < 0)
       throw bokasafn::exceptions::perror("connect");
@@ -111,26 +199,57 @@ public:
       throw bokasafn::exceptions::perror("listen");
   }
 
-  std::shared_ptr<socket<AF, SOCK, PROTO>>
-  accept(saddr & a) const
+  /**
+   * @brief Accept a connection, flags are given to accept4 (SOCK_NONBLOCK, SOCK_CLOEXEC)
+   */
+  socket
+  accept(address & a, int flags = SOCK_CLOEXEC) const
   {
-    socklen_t addrlen = sizeof(sockaddr);
+    socklen_t addrlen = sizeof(address);
 
-    int fd = ::accept(fd_, a.raw(), &addrlen);
+    int fd = ::accept4(fd_, a.raw(), &addrlen, flags);
     if (fd < 0)
-      throw bokasafn::exceptions::perror("accept");
+      throw bokasafn::exceptions::perror("accept4");
+
+    if constexpr (AF == AF_UNIX)
+      a.received(addrlen);
 
-    return std::shared_ptr<socket<AF, SOCK, PROTO>>(new socket<AF, SOCK, PROTO>(fd));
+    return socket(fd);
+  }
+
+  /**
+   * @brief Two connected sockets (socketpair), flags as for accept
+   */
+  static std::pair<socket, socket>
+  pair(int flags = SOCK_CLOEXEC)
+    requires(AF == AF_UNIX)
+  {
+    int fds[ 2 ];
+
+    if (::socketpair(AF, SOCK | flags, PROTO, fds) < 0)
+      throw bokasafn::exceptions::perror("socketpair");
+
+    return {socket(fds[ 0 ]), socket(fds[ 1 ])};
   }
 
 public:
   void
   close()
   {
-    ::close(fd_);
+    if (fd_ >= 0)
+      ::close(fd_);
     fd_ = -1;
   }
 
+  /**
+   * @brief Give up the descriptor without closing it
+   */
+  int
+  release()
+  {
+    return std::exchange(fd_, -1);
+  }
+
 public:
   template <typename O>
   void
@@ -172,25 +291,84 @@ public:
     set_flags(get_flags() & ~flags);
   }
 
+  /**
+   * @brief Join maddr on ifindex, any interface picked by the routes when 0
+   */
+  void
+  join_mgroup(saddr const & maddr, unsigned ifindex = 0) const
+  {
+    if constexpr (AF == AF_INET6)
+      set_option(option<IPPROTO_IPV6, IPV6_JOIN_GROUP, mreq>({maddr, ifindex}));
+    else
+      set_option(option<IPPROTO_IP, IP_ADD_MEMBERSHIP, mreq>({maddr, ifindex}));
+  }
+
+  void
+  leave_mgroup(saddr const & maddr, unsigned ifindex = 0) const
+  {
+    if constexpr (AF == AF_INET6)
+      set_option(option<IPPROTO_IPV6, IPV6_LEAVE_GROUP, mreq>({maddr, ifindex}));
+    else
+      set_option(option<IPPROTO_IP, IP_DROP_MEMBERSHIP, mreq>({maddr, ifindex}));
+  }
+
+  /**
+   * @brief Join maddr for the traffic of source only (SSM)
+   */
   void
-  join_mgroup(saddr const & maddr) const
+  join_mgroup(saddr const & maddr, saddr const & source, unsigned ifindex = 0) const
   {
-    set_option(option<IPPROTO_IP, IP_ADD_MEMBERSHIP, mreq>(maddr));
+    set_option(option<level(), MCAST_JOIN_SOURCE_GROUP, mreq_source>({maddr, source, ifindex}));
   }
 
   void
-  leave_mgroup(saddr const & maddr) const
+  leave_mgroup(saddr const & maddr, saddr const & source, unsigned ifindex = 0) const
   {
-    set_option(option<IPPROTO_IP, IP_DROP_MEMBERSHIP, mreq>(maddr));
+    set_option(option<level(), MCAST_LEAVE_SOURCE_GROUP, mreq_source>({maddr, source, ifindex}));
+  }
+
+  /**
+   * @brief Interface multicast datagrams are sent on
+   */
+  void
+  set_multicast_if(unsigned ifindex) const
+  {
+    if constexpr (AF == AF_INET6)
+      set_option(option<IPPROTO_IPV6, IPV6_MULTICAST_IF, int>(int(ifindex)));
+    else
+    {
+      ip_mreqn req{};
+      req.imr_ifindex = int(ifindex);
+
+      set_option(option<IPPROTO_IP, IP_MULTICAST_IF, ip_mreqn>(req));
+    }
+  }
+
+private:
+  /**
+   * @brief Protocol level of the family, IPPROTO_IP or IPPROTO_IPV6
+   */
+  static constexpr int
+  level()
+  {
+    return AF == AF_INET6 ? IPPROTO_IPV6 : IPPROTO_IP;
   }
 
 public:
   ssize_t
-  recvfrom(saddr & a, void * buffer, size_t size) const
+  recvfrom(address & a, void * buffer, size_t size) const
   {
-    socklen_t addrlen = sizeof(sockaddr);
+    socklen_t addrlen = sizeof(address);
 
-    return ::recvfrom(fd_, buffer, size, 0, a.raw(), &addrlen);
+    auto n = ::recvfrom(fd_, buffer, size, 0, a.raw(), &addrlen);
+
+    if constexpr (AF == AF_UNIX)
+    {
+      if (n >= 0)
+        a.received(addrlen);
+    }
+
+    return n;
   }
 
   ssize_t
@@ -199,9 +377,199 @@ public:
     return ::recv(fd_, buffer, size, flags);
   }
 
+  ssize_t
+  recvmsg(msghdr & msg, int flags = 0) const
+  {
+    return ::recvmsg(fd_, &msg, flags);
+  }
+
+  /**
+   * @brief Receive a datagram along with its kernel arrival time
+   *
+   * Needs so_timestampns, or so_timestamping with SOF_TIMESTAMPING_RX_SOFTWARE (or RX_HARDWARE
+   * with SOF_TIMESTAMPING_RAW_HARDWARE) and SOF_TIMESTAMPING_SOFTWARE.
+   *
+   * ts is reset first, ts.stamped() tells whether this datagram got a stamp: datagrams already
+   * on their way when stamping was enabled may have none.
+   */
+  ssize_t
+  recv_timestamped(void * buffer, size_t size, timestamps & ts, saddr * from = nullptr, int flags = 0) const
+  {
+    iovec iov{buffer, size};
+    alignas(cmsghdr) char control[ 256 ];
+
+    msghdr msg{};
+    msg.msg_name = from ? from->raw() : nullptr;
+    msg.msg_namelen = from ? sizeof(saddr) : 0;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ts = {};
+
+    auto n = ::recvmsg(fd_, &msg, flags);
+    if (n >= 0)
+      ts.parse(msg);
+
+    return n;
+  }
+
+  /**
+   * @brief Read one TX timestamp from the error queue, needs so_timestamping with TX flags
+   *
+   * Shares the error queue with net::zerocopy notifications.
+   *
+   * @return -1 with EAGAIN when none is pending
+   */
+  ssize_t
+  recv_tx_timestamp(timestamps & ts, int flags = 0) const
+  {
+    char payload[ 64 ];
+    iovec iov{payload, sizeof(payload)};
+    alignas(cmsghdr) char control[ 256 ];
+
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ts = {};
+
+    auto n = ::recvmsg(fd_, &msg, flags | MSG_ERRQUEUE);
+    if (n >= 0)
+      ts.parse(msg);
+
+    return n;
+  }
+
+  /**
+   * @brief Scatter the received bytes over count buffers
+   */
+  ssize_t
+  recvv(iovec const * iov, std::size_t count, int flags = 0) const
+  {
+    msghdr msg{};
+    msg.msg_iov = const_cast<iovec *>(iov);
+    msg.msg_iovlen = count;
+
+    return recvmsg(msg, flags);
+  }
+
+  /**
+   * @brief Receive data along with the descriptors attached to it (SCM_RIGHTS)
+   *
+   * count is the room in fds, set to the number received. They are close-on-exec. When the
+   * peer sent more than count, every received descriptor is closed and EMSGSIZE reported.
+   */
+  ssize_t
+  recv_fds(int * fds, std::size_t & count, void * buffer, size_t size, int flags = 0) const
+    requires(AF == AF_UNIX)
+  {
+    iovec iov{buffer, size};
+    alignas(cmsghdr) char control[ CMSG_SPACE(sizeof(int) * MAX_FDS) ];
+
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * std::min(count, MAX_FDS));
+
+    auto n = ::recvmsg(fd_, &msg, flags | MSG_CMSG_CLOEXEC);
+
+    std::size_t room = count;
+    count = 0;
+
+    if (n < 0)
+      return n;
+
+    bool truncated = msg.msg_flags & MSG_CTRUNC;
+
+    for (auto c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+    {
+      if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+        continue;
+
+      auto received = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for (std::size_t i = 0; i < received; ++i)
+      {
+        int fd;
+        std::memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+
+        if (count < room)
+          fds[ count++ ] = fd;
+        else
+        {
+          ::close(fd);
+          truncated = true;
+        }
+      }
+    }
+
+    if (truncated)
+    {
+      for (std::size_t i = 0; i < count; ++i)
+        ::close(fds[ i ]);
+
+      count = 0;
+      errno = EMSGSIZE;
+      return -1;
+    }
+
+    return n;
+  }
+
+  /**
+   * @brief Receive up to count datagrams in one syscall
+   *
+   * With MSG_WAITFORONE, only the first datagram is waited for. count is clamped to N.
+   *
+   * @return the number of datagrams received, -1 on error
+   */
+  template <std::size_t N>
+  int
+  recvmmsg(mmsg<N> & batch, std::size_t count = N, int flags = 0) const
+    requires(SOCK == SOCK_DGRAM)
+  {
+    return ::recvmmsg(fd_, batch.prepare_recv(count), std::min(count, N), flags, nullptr);
+  }
+
+  /**
+   * @brief Receive a datagram, coalesced when udp_gro is set, and view its segments in place
+   */
+  ssize_t
+  recv_gro(segments & out, void * buffer, size_t size, int flags = 0) const
+    requires(SOCK == SOCK_DGRAM)
+  {
+    iovec iov{buffer, size};
+    alignas(cmsghdr) char control[ CMSG_SPACE(sizeof(int)) ];
+
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    auto n = ::recvmsg(fd_, &msg, flags);
+    if (n < 0)
+      return n;
+
+    int segment = 0;
+    for (auto c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+    {
+      if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO)
+        std::memcpy(&segment, CMSG_DATA(c), sizeof(segment));
+    }
+
+    out = segments(buffer, n, segment);
+
+    return n;
+  }
+
 public:
   ssize_t
-  sendto(saddr const & a, void const * buffer, size_t size) const
+  sendto(address const & a, void const * buffer, size_t size) const
   {
     return ::sendto(fd_, buffer, size, 0, a.get(), a.size());
   }
@@ -212,6 +580,133 @@ public:
     return ::send(fd_, buffer, size, flags);
   }
 
+  /**
+   * @brief Send count bytes of file from offset, which is advanced, see net::sendfile_transfer
+   */
+  ssize_t
+  sendfile(int file, off_t & offset, size_t count) const
+    requires(SOCK == SOCK_STREAM)
+  {
+    return ::sendfile(fd_, file, &offset, count);
+  }
+
+  ssize_t
+  sendmsg(msghdr const & msg, int flags = 0) const
+  {
+    return ::sendmsg(fd_, &msg, flags);
+  }
+
+  /**
+   * @brief Gather count buffers in a single send
+   */
+  ssize_t
+  sendv(iovec const * iov, std::size_t count, int flags = 0) const
+  {
+    msghdr msg{};
+    msg.msg_iov = const_cast<iovec *>(iov);
+    msg.msg_iovlen = count;
+
+    return sendmsg(msg, flags);
+  }
+
+  /**
+   * @brief Send the head of c, up to IOV_MAX slices, and consume what was written
+   *
+   * With MSG_MORE the kernel waits for more data before pushing a partial frame.
+   */
+  ssize_t
+  sendv(chain & c, int flags = 0) const
+  {
+    iovec iov[ IOV_MAX ];
+
+    auto n = sendv(iov, c.iov(iov, IOV_MAX), flags);
+    if (n > 0)
+      c.consume(n);
+
+    return n;
+  }
+
+  /**
+   * @brief Send data with count descriptors attached (SCM_RIGHTS), at most MAX_FDS
+   *
+   * The data must not be empty on stream sockets. The descriptors stay open here, the peer
+   * gets its own copies.
+   */
+  ssize_t
+  send_fds(int const * fds, std::size_t count, void const * buffer, size_t size, int flags = 0) const
+    requires(AF == AF_UNIX)
+  {
+    if (count > MAX_FDS)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+    iovec iov{const_cast<void *>(buffer), size};
+    alignas(cmsghdr) char control[ CMSG_SPACE(sizeof(int) * MAX_FDS) ] = {};
+
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (count)
+    {
+      msg.msg_control = control;
+      msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+      auto c = CMSG_FIRSTHDR(&msg);
+      c->cmsg_level = SOL_SOCKET;
+      c->cmsg_type = SCM_RIGHTS;
+      c->cmsg_len = CMSG_LEN(sizeof(int) * count);
+      std::memcpy(CMSG_DATA(c), fds, sizeof(int) * count);
+    }
+
+    return ::sendmsg(fd_, &msg, flags | MSG_NOSIGNAL);
+  }
+
+  /**
+   * @brief Send the first count datagrams of batch in one syscall, at most N
+   *
+   * @return the number of datagrams sent, -1 on error
+   */
+  template <std::size_t N>
+  int
+  sendmmsg(mmsg<N> & batch, std::size_t count = N, int flags = 0) const
+    requires(SOCK == SOCK_DGRAM)
+  {
+    return ::sendmmsg(fd_, batch.prepare_send(count), std::min(count, N), flags);
+  }
+
+  /**
+   * @brief Send size bytes as datagrams of segment bytes in one syscall (UDP_SEGMENT)
+   *
+   * The kernel caps a call to 64 segments and 64KB. The destination is left out on
+   * connected sockets.
+   */
+  ssize_t
+  send_gso(void const * buffer, size_t size, std::uint16_t segment, saddr const & to = {}, int flags = 0) const
+    requires(SOCK == SOCK_DGRAM)
+  {
+    iovec iov{const_cast<void *>(buffer), size};
+    alignas(cmsghdr) char control[ CMSG_SPACE(sizeof(segment)) ] = {};
+
+    msghdr msg{};
+    msg.msg_name = const_cast<sockaddr *>(to.get());
+    msg.msg_namelen = to.size();
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    auto c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_UDP;
+    c->cmsg_type = UDP_SEGMENT;
+    c->cmsg_len = CMSG_LEN(sizeof(segment));
+    std::memcpy(CMSG_DATA(c), &segment, sizeof(segment));
+
+    return ::sendmsg(fd_, &msg, flags);
+  }
+
 public:
   int
   fd() const
@@ -223,6 +718,30 @@ private:
   int fd_;
 };
 
+/**
+ * @brief Cork a TCP socket for the guard lifetime, frames are pushed once uncorked
+ */
+template <typename S>
+class cork
+{
+public:
+  cork(S const & s) : s_(s) { s_.set_option(tcp_cork(true)); }
+
+  ~cork()
+  {
+    int off = 0;
+
+    setsockopt(s_.fd(), IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
+  }
+
+  cork(cork const &) = delete;
+  cork &
+  operator=(cork const &) = delete;
+
+private:
+  S const & s_;
+};
+
 namespace ipv4
 {
 
@@ -238,6 +757,15 @@ using tcp = socket<AF_INET6, SOCK_STREAM, IPPROTO_TCP>;
 using udp = socket<AF_INET6, SOCK_DGRAM, IPPROTO_UDP>;
 
 } /** !ipv6 */
+
+namespace local
+{
+
+using stream = socket<AF_UNIX, SOCK_STREAM, 0>;
+using dgram = socket<AF_UNIX, SOCK_DGRAM, 0>;
+using seqpacket = socket<AF_UNIX, SOCK_SEQPACKET, 0>;
+
+} /** !local */
 } /** !net */
 } /** !bokasafn */
 
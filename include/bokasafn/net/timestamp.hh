@@ -0,0 +1,117 @@
+/**
+ *  @file timestamp.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_TIMESTAMP_HH_
+#define BOKASAFN_NET_TIMESTAMP_HH_
+
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief Kernel timestamps attached to a received datagram or to a TX error queue entry
+ *
+ * Timestamps are CLOCK_REALTIME, unset ones are the epoch.
+ */
+struct timestamps
+{
+  using clock = std::chrono::system_clock;
+
+  clock::time_point software{};
+  clock::time_point hardware{};
+
+  /**
+   * @brief TX only: SCM_TSTAMP_SND, SCM_TSTAMP_SCHED or SCM_TSTAMP_ACK
+   */
+  int type = -1;
+
+  /**
+   * @brief TX only: the send counter with SOF_TIMESTAMPING_OPT_ID
+   */
+  std::uint32_t id = 0;
+
+  /**
+   * @brief Whether the kernel attached a software or hardware stamp
+   */
+  bool
+  stamped() const
+  {
+    return software != clock::time_point{} || hardware != clock::time_point{};
+  }
+
+  static clock::time_point
+  convert(timespec const & ts)
+  {
+    return clock::time_point(std::chrono::duration_cast<clock::duration>(std::chrono::seconds(ts.tv_sec) +
+                                                                         std::chrono::nanoseconds(ts.tv_nsec)));
+  }
+
+  /**
+   * @brief Read the SCM_TIMESTAMPNS / SCM_TIMESTAMPING control messages of msg
+   *
+   * @return whether a timestamp was found
+   */
+  bool
+  parse(msghdr const & msg)
+  {
+    bool found = false;
+
+    for (auto c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(const_cast<msghdr *>(&msg), c))
+    {
+      if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS)
+      {
+        timespec ts;
+        std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+
+        software = convert(ts);
+        found = true;
+      }
+      else if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPING)
+      {
+        scm_timestamping ts;
+        std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+
+        // Zero when the kernel had nothing to stamp with
+        if (ts.ts[ 0 ].tv_sec || ts.ts[ 0 ].tv_nsec)
+        {
+          software = convert(ts.ts[ 0 ]);
+          found = true;
+        }
+        if (ts.ts[ 2 ].tv_sec || ts.ts[ 2 ].tv_nsec)
+        {
+          hardware = convert(ts.ts[ 2 ]);
+          found = true;
+        }
+      }
+      else if ((c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR) ||
+               (c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR))
+      {
+        sock_extended_err err;
+        std::memcpy(&err, CMSG_DATA(c), sizeof(err));
+
+        if (err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING)
+        {
+          type = err.ee_info;
+          id = err.ee_data;
+        }
+      }
+    }
+
+    return found;
+  }
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_TIMESTAMP_HH_ */
@@ -0,0 +1,274 @@
+/**
+ *  @file transfer.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_TRANSFER_HH_
+#define BOKASAFN_NET_TRANSFER_HH_
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <functional>
+
+#include <bokasafn/exceptions.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief What a transfer waits for after a pump()
+ */
+enum class progress
+{
+  done,
+  want_in,
+  want_out,
+  error,
+};
+
+/**
+ * @brief File range to a socket with sendfile, the bytes never reach user space
+ *
+ * pump() sends until the socket would block. attach() drives it from EPOLLOUT, its handler is
+ * added to the socket ones, which should have none left for the transfer lifetime.
+ */
+class sendfile_transfer
+{
+public:
+  using done_t = std::function<void(int)>;
+
+  static constexpr std::size_t CHUNK = 1 << 20;
+
+public:
+  sendfile_transfer(int out, int file, off_t offset, std::size_t count)
+    : out_(out), file_(file), offset_(offset), left_(count)
+  {
+  }
+
+public:
+  /**
+   * @brief An end of file before count bytes is an error with ENODATA, left() tells what is missing
+   */
+  progress
+  pump()
+  {
+    while (left_)
+    {
+      auto n = ::sendfile(out_, file_, &offset_, std::min(left_, CHUNK));
+
+      if (n < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK ? progress::want_out : progress::error;
+
+      if (n == 0)
+      {
+        errno = ENODATA;
+        return progress::error;
+      }
+
+      left_ -= n;
+    }
+
+    return progress::done;
+  }
+
+  /**
+   * @brief Pump on every EPOLLOUT, then call done with 0 or the errno
+   */
+  template <typename E>
+  void
+  attach(E & e, done_t done)
+  {
+    e.add(out_, [this, done](int) {
+      auto p = pump();
+      if (p == progress::want_out)
+        return true;
+
+      done(p == progress::done ? 0 : errno);
+
+      return false;
+    }, EPOLLOUT | EPOLLERR | EPOLLHUP);
+  }
+
+public:
+  std::size_t
+  left() const
+  {
+    return left_;
+  }
+
+private:
+  int out_;
+  int file_;
+  off_t offset_;
+  std::size_t left_;
+};
+
+/**
+ * @brief Descriptor to socket proxy through a pipe with splice, until EOF on the input
+ *
+ * Pages move from the input to the pipe and from the pipe to the output without a copy to
+ * user space. attach() arms EPOLLIN on the input or EPOLLOUT on the output, never both, and
+ * adds its handlers to theirs like sendfile_transfer.
+ *
+ * An error on the side not armed ends the transfer, so does a hangup of the output. A hangup
+ * of the input only parks it until the output drained what was buffered.
+ */
+class splice_transfer
+{
+public:
+  using done_t = std::function<void(int)>;
+
+  static constexpr std::size_t CHUNK = 1 << 16;
+
+public:
+  splice_transfer(int in, int out)
+    : in_(in), out_(out), buffered_(0), total_(0), waiting_(progress::want_in), parked_(false)
+  {
+    if (pipe2(pipe_, O_NONBLOCK | O_CLOEXEC) < 0)
+      throw bokasafn::exceptions::perror("pipe2");
+  }
+
+  ~splice_transfer()
+  {
+    ::close(pipe_[ 0 ]);
+    ::close(pipe_[ 1 ]);
+  }
+
+  splice_transfer(splice_transfer const &) = delete;
+  splice_transfer &
+  operator=(splice_transfer const &) = delete;
+
+public:
+  progress
+  pump()
+  {
+    for (;;)
+    {
+      if (buffered_)
+      {
+        auto n = ::splice(pipe_[ 0 ], nullptr, out_, nullptr, buffered_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+        if (n < 0)
+          return errno == EAGAIN ? progress::want_out : progress::error;
+
+        buffered_ -= n;
+        total_ += n;
+        continue;
+      }
+
+      auto n = ::splice(in_, nullptr, pipe_[ 1 ], nullptr, CHUNK, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+      if (n < 0)
+        return errno == EAGAIN ? progress::want_in : progress::error;
+
+      if (n == 0)
+        return progress::done;
+
+      buffered_ += n;
+    }
+  }
+
+  /**
+   * @brief Pump on readiness of either side, then call done with 0 or the errno
+   */
+  template <typename E>
+  void
+  attach(E & e, done_t done)
+  {
+    auto handler = [this, &e, done](int fd) {
+      auto finish = [this, &e, &done, fd](int err) {
+        // The running handler is removed by the loop once it returns
+        e.remove(fd == in_ ? out_ : in_);
+        done(err);
+
+        return false;
+      };
+
+      // Not armed on this side: only an error or a hangup wakes it
+      if (fd == (waiting_ == progress::want_in ? out_ : in_))
+      {
+        int err = error(fd);
+        if (err || fd == out_)
+          return finish(err ? err : EPIPE);
+
+        parked_ = true;
+        return false;
+      }
+
+      auto p = pump();
+
+      if (p == progress::want_in || p == progress::want_out)
+      {
+        waiting_ = p;
+
+        if (p == progress::want_in && parked_)
+        {
+          parked_ = false;
+          e.add(in_, handler_, EPOLLIN | EPOLLERR | EPOLLHUP);
+        }
+
+        e.modify(in_, p == progress::want_in ? int(EPOLLIN) : 0);
+        e.modify(out_, p == progress::want_out ? int(EPOLLOUT) : 0);
+        return true;
+      }
+
+      return finish(p == progress::done ? 0 : errno);
+    };
+
+    handler_ = handler;
+
+    e.add(in_, handler, EPOLLIN | EPOLLERR | EPOLLHUP);
+    e.add(out_, handler, EPOLLOUT | EPOLLERR | EPOLLHUP);
+    e.modify(out_, 0);
+  }
+
+public:
+  /**
+   * @brief Bytes written to the output so far
+   */
+  std::size_t
+  total() const
+  {
+    return total_;
+  }
+
+private:
+  /**
+   * @brief Pending error of a socket, 0 for other descriptors
+   */
+  static int
+  error(int fd)
+  {
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+      return 0;
+
+    return err;
+  }
+
+private:
+  int in_;
+  int out_;
+  int pipe_[ 2 ];
+  std::size_t buffered_;
+  std::size_t total_;
+
+  progress waiting_;
+  bool parked_;
+  std::function<bool(int)> handler_;
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_TRANSFER_HH_ */
@@ -0,0 +1,180 @@
+/**
+ *  @file zerocopy.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_NET_ZEROCOPY_HH_
+#define BOKASAFN_NET_ZEROCOPY_HH_
+
+#include <linux/errqueue.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+
+#include <bokasafn/exceptions.hh>
+#include <bokasafn/net/socket.hh>
+
+namespace bokasafn
+{
+namespace net
+{
+
+/**
+ * @brief MSG_ZEROCOPY sender over a connected socket
+ *
+ * Every send() accepting bytes is acknowledged once through the release callback, with the
+ * cookie given to send() (the buffer by default): right away for a copied send, once the
+ * kernel notifies it for a zero-copy one. Until then the buffer must stay untouched.
+ *
+ * Sends below the threshold are copied, pinning pages and reading the notification costs
+ * more than copying them. When the kernel reports it had to copy anyway (loopback, devices
+ * without scatter-gather) every following send is copied too.
+ */
+template <typename S>
+class zerocopy
+{
+public:
+  using release_t = std::function<void(void const *, bool)>;
+
+  static constexpr std::size_t THRESHOLD = 16384;
+
+private:
+  struct pending_t
+  {
+    void const * cookie;
+    bool done;
+  };
+
+public:
+  zerocopy(S const & s, release_t release, std::size_t threshold = THRESHOLD)
+    : fd_(s.fd()), release_(release), threshold_(threshold), copying_(false), base_(0)
+  {
+    s.set_option(option<SOL_SOCKET, SO_ZEROCOPY, int>(true));
+  }
+
+public:
+  ssize_t
+  send(void const * buffer, std::size_t size, void const * cookie = nullptr, int flags = 0)
+  {
+    if (!cookie)
+      cookie = buffer;
+
+    bool zc = !copying_ && size >= threshold_;
+
+    auto n = ::send(fd_, buffer, size, flags | (zc ? MSG_ZEROCOPY : 0));
+    if (n < 0)
+      return n;
+
+    if (zc)
+      pending_.push_back({cookie, false});
+    else
+      release_(cookie, true);
+
+    return n;
+  }
+
+  /**
+   * @brief Read the notifications from the error queue and release the acknowledged buffers
+   */
+  void
+  complete()
+  {
+    alignas(cmsghdr) char control[ 128 ];
+
+    for (;;)
+    {
+      msghdr msg{};
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+
+      if (::recvmsg(fd_, &msg, MSG_ERRQUEUE) < 0)
+      {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          return;
+
+        throw bokasafn::exceptions::perror("recvmsg(MSG_ERRQUEUE)");
+      }
+
+      for (auto c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+      {
+        if (!(c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR) &&
+            !(c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR))
+          continue;
+
+        sock_extended_err err;
+        std::memcpy(&err, CMSG_DATA(c), sizeof(err));
+
+        if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+          continue;
+
+        bool copied = err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED;
+        if (copied)
+          copying_ = true;
+
+        for (std::uint32_t seq = err.ee_info; seq - err.ee_info <= err.ee_data - err.ee_info; ++seq)
+          acknowledge(seq, copied);
+      }
+    }
+  }
+
+  /**
+   * @brief Read the notifications when fd reports EPOLLERR
+   */
+  template <typename E>
+  void
+  attach(E & e)
+  {
+    e.add(fd_, [this](int) {
+      complete();
+      return true;
+    }, EPOLLERR);
+  }
+
+public:
+  std::size_t
+  pending() const
+  {
+    return pending_.size();
+  }
+
+  bool
+  copying() const
+  {
+    return copying_;
+  }
+
+private:
+  void
+  acknowledge(std::uint32_t seq, bool copied)
+  {
+    std::uint32_t i = seq - base_;
+    if (i >= pending_.size() || pending_[ i ].done)
+      return;
+
+    pending_[ i ].done = true;
+    release_(pending_[ i ].cookie, copied);
+
+    while (!pending_.empty() && pending_.front().done)
+    {
+      pending_.pop_front();
+      base_++;
+    }
+  }
+
+private:
+  int fd_;
+  release_t release_;
+  std::size_t threshold_;
+  bool copying_;
+
+  std::uint32_t base_;
+  std::deque<pending_t> pending_;
+};
+
+} /** !net */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_NET_ZEROCOPY_HH_ */
@@ -0,0 +1,524 @@
+/**
+ *  @file pool.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_POOL_HH_
+#define BOKASAFN_POOL_HH_
+
+#include <sys/mman.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <bokasafn/exceptions.hh>
+
+namespace bokasafn
+{
+
+class buffer_pool;
+
+namespace detail
+{
+
+struct shard_t;
+
+struct alignas(64) block_t
+{
+  std::atomic<std::uint32_t> refs;
+  shard_t * owner;
+  block_t * next;
+  char * data;
+};
+
+/**
+ * @brief Free buffers of one thread
+ *
+ * The owner thread pops and pushes the local list without synchronisation. Other threads push
+ * the buffers they release onto the remote stack, which the owner takes whole once its local
+ * list is empty.
+ */
+struct alignas(64) shard_t
+{
+  block_t * local = nullptr;
+  std::size_t count = 0;
+
+  alignas(64) std::atomic<block_t *> remote{nullptr};
+};
+
+/**
+ * @brief Live pools, so that exiting threads only give their shards back to those
+ */
+struct pools_t
+{
+  std::mutex mutex;
+  std::unordered_map<std::uint64_t, buffer_pool *> live;
+
+  static pools_t &
+  instance()
+  {
+    static pools_t p;
+
+    return p;
+  }
+};
+
+/**
+ * @brief Shards of the calling thread, one per pool it used
+ */
+struct thread_shards_t
+{
+  std::vector<std::pair<std::uint64_t, shard_t *>> shards;
+
+  ~thread_shards_t();
+
+  static thread_shards_t &
+  instance()
+  {
+    thread_local thread_shards_t t;
+
+    return t;
+  }
+};
+
+} /** !detail */
+
+/**
+ * @brief Reference counted slice of a pooled buffer
+ *
+ * Copies and slices share the buffer, which goes back to its pool with the last of them. They
+ * must not outlive the pool.
+ */
+class buffer
+{
+public:
+  buffer() : pool_(nullptr), block_(nullptr), data_(nullptr), size_(0) {}
+
+  buffer(buffer const & other) : pool_(other.pool_), block_(other.block_), data_(other.data_), size_(other.size_)
+  {
+    if (block_)
+      block_->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  buffer(buffer && other) noexcept
+    : pool_(std::exchange(other.pool_, nullptr)), block_(std::exchange(other.block_, nullptr)),
+      data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0))
+  {
+  }
+
+  buffer &
+  operator=(buffer other) noexcept
+  {
+    std::swap(pool_, other.pool_);
+    std::swap(block_, other.block_);
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+
+    return *this;
+  }
+
+  ~buffer() { reset(); }
+
+public:
+  char *
+  data() const
+  {
+    return data_;
+  }
+
+  std::size_t
+  size() const
+  {
+    return size_;
+  }
+
+  bool
+  empty() const
+  {
+    return !size_;
+  }
+
+  explicit operator bool() const { return block_ != nullptr; }
+
+  /**
+   * @brief size bytes from offset, sharing this buffer
+   */
+  buffer
+  slice(std::size_t offset, std::size_t size) const
+  {
+    buffer b(*this);
+
+    b.data_ += offset;
+    b.size_ = size;
+
+    return b;
+  }
+
+  /**
+   * @brief Shrink to the bytes actually filled, after a receive for instance
+   */
+  void
+  resize(std::size_t size)
+  {
+    size_ = size;
+  }
+
+  /**
+   * @brief Owner holding a reference, for APIs taking a shared_ptr
+   *
+   * Allocates a control block: net::chain takes the buffer itself instead.
+   */
+  std::shared_ptr<void const>
+  share() const
+  {
+    auto keep = std::make_shared<buffer>(*this);
+
+    return std::shared_ptr<void const>(keep, keep->data());
+  }
+
+  std::uint32_t
+  use_count() const
+  {
+    return block_ ? block_->refs.load(std::memory_order_relaxed) : 0;
+  }
+
+  void
+  reset();
+
+private:
+  friend class buffer_pool;
+
+  buffer(buffer_pool * pool, detail::block_t * block, std::size_t size)
+    : pool_(pool), block_(block), data_(block->data), size_(size)
+  {
+  }
+
+private:
+  buffer_pool * pool_;
+  detail::block_t * block_;
+  char * data_;
+  std::size_t size_;
+};
+
+/**
+ * @brief Fixed size buffers carved out of one huge page region
+ *
+ * The region is mapped with MAP_HUGETLB when huge pages are reserved, transparent huge pages
+ * are asked for otherwise, either way the buffers cost few TLB entries. Buffers are cache
+ * line aligned. Each thread allocates from and releases to its own free list. Buffers
+ * released by another thread go back to their allocating thread through a lock-free stack.
+ * Free lists overflow to and refill from a shared list by batches, under a mutex.
+ */
+class buffer_pool
+{
+public:
+  static constexpr std::size_t BATCH = 32;
+  static constexpr std::size_t HUGE_PAGE = 2 << 20;
+
+public:
+  buffer_pool(std::size_t size, std::size_t count)
+    : id_(next_id()), size_(size), stride_((size + 63) / 64 * 64), count_(count), huge_(true),
+      blocks_(new detail::block_t[ count ])
+  {
+    length_ = (stride_ * count_ + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+
+    auto region = mmap(nullptr, length_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (region == MAP_FAILED)
+    {
+      huge_ = false;
+
+      region = mmap(nullptr, length_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (region == MAP_FAILED)
+        throw bokasafn::exceptions::perror("mmap");
+
+      madvise(region, length_, MADV_HUGEPAGE);
+    }
+
+    region_ = static_cast<char *>(region);
+
+    central_.reserve(count_);
+    for (std::size_t i = count_; i-- > 0;)
+    {
+      blocks_[ i ].refs.store(0, std::memory_order_relaxed);
+      blocks_[ i ].owner = nullptr;
+      blocks_[ i ].next = nullptr;
+      blocks_[ i ].data = region_ + i * stride_;
+
+      central_.push_back(&blocks_[ i ]);
+    }
+
+    auto & pools = detail::pools_t::instance();
+    std::lock_guard<std::mutex> lock(pools.mutex);
+    pools.live[ id_ ] = this;
+  }
+
+  /**
+   * @brief Every buffer must have been released
+   */
+  ~buffer_pool()
+  {
+    {
+      auto & pools = detail::pools_t::instance();
+      std::lock_guard<std::mutex> lock(pools.mutex);
+      pools.live.erase(id_);
+    }
+
+    munmap(region_, length_);
+  }
+
+  buffer_pool(buffer_pool const &) = delete;
+  buffer_pool &
+  operator=(buffer_pool const &) = delete;
+
+public:
+  /**
+   * @brief A buffer of size() bytes, an empty one when the pool is exhausted
+   */
+  buffer
+  acquire()
+  {
+    auto & s = local();
+
+    if (!s.local)
+      refill(s);
+
+    if (!s.local)
+      return {};
+
+    auto b = s.local;
+    s.local = b->next;
+    s.count--;
+
+    b->refs.store(1, std::memory_order_relaxed);
+    b->owner = &s;
+
+    return buffer(this, b, size_);
+  }
+
+  /**
+   * @brief Fill [first, last) with buffers, as long as the pool has some
+   *
+   * @return the number of buffers acquired
+   */
+  template <typename It>
+  std::size_t
+  acquire(It first, It last)
+  {
+    std::size_t n = 0;
+
+    for (; first != last; ++first, ++n)
+    {
+      *first = acquire();
+      if (!*first)
+        break;
+    }
+
+    return n;
+  }
+
+  std::size_t
+  size() const
+  {
+    return size_;
+  }
+
+  std::size_t
+  count() const
+  {
+    return count_;
+  }
+
+  /**
+   * @brief Backed by reserved huge pages (MAP_HUGETLB), not only transparent ones
+   */
+  bool
+  huge() const
+  {
+    return huge_;
+  }
+
+private:
+  friend class buffer;
+  friend struct detail::thread_shards_t;
+
+  static std::uint64_t
+  next_id()
+  {
+    static std::atomic<std::uint64_t> id{0};
+
+    return ++id;
+  }
+
+  detail::shard_t &
+  local()
+  {
+    auto & t = detail::thread_shards_t::instance();
+
+    for (auto const & [ id, shard ] : t.shards)
+    {
+      if (id == id_)
+        return *shard;
+    }
+
+    // First use from this thread, adopt the shard of an exited thread if any
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    detail::shard_t * s;
+    if (orphans_.empty())
+    {
+      shards_.emplace_back(new detail::shard_t);
+      s = shards_.back().get();
+    }
+    else
+    {
+      s = orphans_.back();
+      orphans_.pop_back();
+    }
+
+    t.shards.push_back({id_, s});
+
+    return *s;
+  }
+
+  void
+  refill(detail::shard_t & s)
+  {
+    s.local = s.remote.exchange(nullptr, std::memory_order_acquire);
+    for (auto b = s.local; b; b = b->next)
+      s.count++;
+
+    if (s.local)
+      return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Buffers released to exited threads
+    if (central_.empty())
+    {
+      for (auto o : orphans_)
+      {
+        for (auto b = o->remote.exchange(nullptr, std::memory_order_acquire); b;)
+        {
+          auto next = b->next;
+          central_.push_back(b);
+          b = next;
+        }
+      }
+    }
+
+    for (std::size_t i = 0; i < BATCH && !central_.empty(); ++i)
+    {
+      auto b = central_.back();
+      central_.pop_back();
+
+      b->next = s.local;
+      s.local = b;
+      s.count++;
+    }
+  }
+
+  void
+  release(detail::block_t * b)
+  {
+    auto & s = local();
+    auto owner = b->owner;
+
+    if (owner != &s)
+    {
+      auto head = owner->remote.load(std::memory_order_relaxed);
+      do
+        b->next = head;
+      while (!owner->remote.compare_exchange_weak(head, b, std::memory_order_release, std::memory_order_relaxed));
+
+      return;
+    }
+
+    b->next = s.local;
+    s.local = b;
+
+    if (++s.count <= 2 * BATCH)
+      return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (std::size_t i = 0; i < BATCH; ++i)
+    {
+      auto spilled = s.local;
+      s.local = spilled->next;
+      s.count--;
+
+      central_.push_back(spilled);
+    }
+  }
+
+  /**
+   * @brief The thread of s exited, its free buffers go to the shared list
+   */
+  void
+  abandon(detail::shard_t * s)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto b = s->local; b;)
+    {
+      auto next = b->next;
+      central_.push_back(b);
+      b = next;
+    }
+
+    s->local = nullptr;
+    s->count = 0;
+
+    orphans_.push_back(s);
+  }
+
+private:
+  std::uint64_t id_;
+  std::size_t size_;
+  std::size_t stride_;
+  std::size_t count_;
+  std::size_t length_;
+  bool huge_;
+
+  char * region_;
+  std::unique_ptr<detail::block_t[]> blocks_;
+
+  std::mutex mutex_;
+  std::vector<detail::block_t *> central_;
+  std::vector<std::unique_ptr<detail::shard_t>> shards_;
+  std::vector<detail::shard_t *> orphans_;
+};
+
+inline void
+buffer::reset()
+{
+  if (block_ && block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    pool_->release(block_);
+
+  pool_ = nullptr;
+  block_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+inline detail::thread_shards_t::~thread_shards_t()
+{
+  auto & pools = pools_t::instance();
+  std::lock_guard<std::mutex> lock(pools.mutex);
+
+  for (auto const & [ id, shard ] : shards)
+  {
+    auto it = pools.live.find(id);
+    if (it != pools.live.end())
+      it->second->abandon(shard);
+  }
+}
+
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_POOL_HH_ */
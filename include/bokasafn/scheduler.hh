@@ -0,0 +1,319 @@
+/**
+ *  @file scheduler.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_SCHEDULER_HH_
+#define BOKASAFN_SCHEDULER_HH_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace bokasafn
+{
+
+/**
+ * @brief Timers served by a single thread from a deadline heap
+ *
+ * Callbacks run on the scheduler thread and must stay short, a slow callback delays every
+ * other timer. Cancelled timers stay in the heap until they expire or until they are more
+ * than half of it, then the heap is rebuilt.
+ */
+class scheduler
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+private:
+  enum state_t : int
+  {
+    armed,
+    running,
+    cancelled,
+    finished,
+  };
+
+  struct entry_t
+  {
+    entry_t(std::function<void()> f, clock::duration period, std::shared_ptr<std::atomic<std::size_t>> stale)
+      : f(std::move(f)), period(period), stale(std::move(stale)), state(armed)
+    {
+    }
+
+    std::function<void()> f;
+    clock::duration period;
+    std::shared_ptr<std::atomic<std::size_t>> stale;
+    std::atomic<int> state;
+  };
+
+  struct node_t
+  {
+    clock::time_point deadline;
+    std::uint64_t seq;
+    std::shared_ptr<entry_t> entry;
+
+    bool
+    operator>(node_t const & other) const
+    {
+      return deadline != other.deadline ? deadline > other.deadline : seq > other.seq;
+    }
+  };
+
+public:
+  /**
+   * @brief Reference to a scheduled timer, copies refer to the same timer
+   */
+  class handle
+  {
+  public:
+    handle() = default;
+
+  public:
+    /**
+     * @brief Prevent any further call, O(1) and safe from any thread, callbacks included
+     */
+    void
+    cancel()
+    {
+      if (!entry_)
+        return;
+
+      int s = armed;
+      if (entry_->state.compare_exchange_strong(s, finished))
+      {
+        entry_->stale->fetch_add(1, std::memory_order_relaxed);
+        entry_->state.notify_all();
+        return;
+      }
+
+      s = running;
+      entry_->state.compare_exchange_strong(s, cancelled);
+    }
+
+    /**
+     * @brief Block until the timer will not run anymore: fired once, or cancelled and idle
+     */
+    void
+    wait() const
+    {
+      if (!entry_)
+        return;
+
+      for (int s = entry_->state.load(); s != finished; s = entry_->state.load())
+        entry_->state.wait(s);
+    }
+
+    bool
+    active() const
+    {
+      return entry_ && entry_->state.load() != finished;
+    }
+
+  private:
+    friend class scheduler;
+
+    explicit handle(std::shared_ptr<entry_t> entry) : entry_(std::move(entry)) {}
+
+  private:
+    std::shared_ptr<entry_t> entry_;
+  };
+
+public:
+  scheduler() : running_(true), seq_(0), stale_(std::make_shared<std::atomic<std::size_t>>(0))
+  {
+    thread_ = std::thread([this]() { run(); });
+  }
+
+  ~scheduler()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  scheduler(scheduler const &) = delete;
+  scheduler &
+  operator=(scheduler const &) = delete;
+
+  /**
+   * @brief Process wide scheduler, started on first use
+   */
+  static scheduler &
+  instance()
+  {
+    static scheduler s;
+
+    return s;
+  }
+
+public:
+  template <typename P, typename R, typename F>
+  handle
+  after(std::chrono::duration<P, R> delay, F f)
+  {
+    return schedule(clock::now() + std::chrono::duration_cast<clock::duration>(delay), clock::duration::zero(), f);
+  }
+
+  template <typename F>
+  handle
+  at(clock::time_point deadline, F f)
+  {
+    return schedule(deadline, clock::duration::zero(), f);
+  }
+
+  /**
+   * @brief Call f every period, ticks are on deadlines so the callback time does not drift them
+   *
+   * Ticks missed because a callback overran are skipped.
+   */
+  template <typename P, typename R, typename F>
+  handle
+  every(std::chrono::duration<P, R> period, F f)
+  {
+    auto p = std::chrono::duration_cast<clock::duration>(period);
+
+    return schedule(clock::now() + p, p, f);
+  }
+
+  std::size_t
+  size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return heap_.size();
+  }
+
+private:
+  handle
+  schedule(clock::time_point deadline, clock::duration period, std::function<void()> f)
+  {
+    auto entry = std::make_shared<entry_t>(std::move(f), period, stale_);
+
+    push(deadline, entry);
+
+    return handle(std::move(entry));
+  }
+
+  void
+  push(clock::time_point deadline, std::shared_ptr<entry_t> entry)
+  {
+    bool earliest;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      earliest = heap_.empty() || deadline < heap_.top().deadline;
+      heap_.push({deadline, seq_++, std::move(entry)});
+    }
+
+    if (earliest)
+      cv_.notify_one();
+  }
+
+  void
+  compact()
+  {
+    std::vector<node_t> live;
+
+    while (!heap_.empty())
+    {
+      if (heap_.top().entry->state.load() != finished)
+        live.push_back(heap_.top());
+      heap_.pop();
+    }
+
+    heap_ = decltype(heap_)(std::greater<node_t>(), std::move(live));
+    stale_->store(0, std::memory_order_relaxed);
+  }
+
+  void
+  run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (running_)
+    {
+      if (stale_->load(std::memory_order_relaxed) > heap_.size() / 2 && heap_.size() > 64)
+        compact();
+
+      if (heap_.empty())
+      {
+        cv_.wait(lock);
+        continue;
+      }
+
+      auto deadline = heap_.top().deadline;
+      if (clock::now() < deadline)
+      {
+        cv_.wait_until(lock, deadline);
+        continue;
+      }
+
+      auto node = heap_.top();
+      heap_.pop();
+
+      int s = armed;
+      if (!node.entry->state.compare_exchange_strong(s, running))
+      {
+        auto & stale = *stale_;
+        if (stale.load(std::memory_order_relaxed))
+          stale.fetch_sub(1, std::memory_order_relaxed);
+        continue;
+      }
+
+      lock.unlock();
+      fire(node);
+      lock.lock();
+    }
+  }
+
+  void
+  fire(node_t & node)
+  {
+    auto & e = *node.entry;
+
+    e.f();
+
+    int s = running;
+    if (e.period == clock::duration::zero() || !e.state.compare_exchange_strong(s, armed))
+    {
+      e.state.store(finished);
+      e.state.notify_all();
+      return;
+    }
+
+    auto now = clock::now();
+
+    node.deadline += e.period;
+    if (node.deadline <= now)
+      node.deadline += ((now - node.deadline) / e.period + 1) * e.period;
+
+    push(node.deadline, std::move(node.entry));
+  }
+
+private:
+  bool running_;
+  std::uint64_t seq_;
+  std::shared_ptr<std::atomic<std::size_t>> stale_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::priority_queue<node_t, std::vector<node_t>, std::greater<node_t>> heap_;
+
+  std::thread thread_;
+};
+
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_SCHEDULER_HH_ */
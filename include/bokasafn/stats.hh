@@ -0,0 +1,329 @@
+/**
+ *  @file stats.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_STATS_HH_
+#define BOKASAFN_STATS_HH_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+
+namespace bokasafn
+{
+namespace stats
+{
+
+using clock = std::chrono::steady_clock;
+
+/**
+ * @brief Power of two buckets, bucket i counts values in [2^(i-1), 2^i)
+ *
+ * Single writer, counters can be read from any thread.
+ */
+class histogram
+{
+public:
+  static constexpr std::size_t BUCKETS = 64;
+
+public:
+  void
+  add(std::uint64_t v)
+  {
+    bump(buckets_[ bucket(v) ], 1);
+    bump(count_, 1);
+    bump(sum_, v);
+
+    if (v > max_.load(std::memory_order_relaxed))
+      max_.store(v, std::memory_order_relaxed);
+  }
+
+  template <typename P, typename R>
+  void
+  add(std::chrono::duration<P, R> dur)
+  {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count();
+
+    add(static_cast<std::uint64_t>(ns < 0 ? 0 : ns));
+  }
+
+public:
+  static constexpr std::size_t
+  bucket(std::uint64_t v)
+  {
+    return v ? std::min<std::size_t>(64 - __builtin_clzll(v), BUCKETS - 1) : 0;
+  }
+
+  std::uint64_t
+  at(std::size_t bucket) const
+  {
+    return buckets_[ bucket ].load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t
+  count() const
+  {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t
+  sum() const
+  {
+    return sum_.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t
+  max() const
+  {
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Upper bound of the bucket holding the q quantile
+   */
+  std::uint64_t
+  quantile(double q) const
+  {
+    auto n = count();
+    std::uint64_t seen = 0;
+
+    for (std::size_t i = 0; i < BUCKETS; ++i)
+    {
+      seen += at(i);
+      if (n && seen >= q * n)
+        return i ? (std::uint64_t(1) << i) - 1 : 0;
+    }
+
+    return max();
+  }
+
+private:
+  static void
+  bump(std::atomic<std::uint64_t> & c, std::uint64_t v)
+  {
+    c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+  }
+
+private:
+  std::array<std::atomic<std::uint64_t>, BUCKETS> buckets_{};
+  std::atomic<std::uint64_t> count_{0};
+  std::atomic<std::uint64_t> sum_{0};
+  std::atomic<std::uint64_t> max_{0};
+};
+
+/**
+ * @brief A handler that ran longer than the slow threshold
+ */
+struct slow_t
+{
+  int fd;
+  std::chrono::nanoseconds duration;
+  clock::time_point at;
+};
+
+/**
+ * @brief Fixed size ring of the last N slow handlers
+ *
+ * The loop thread pushes, any thread may dump. Each slot is a seqlock, a slot being
+ * overwritten while dumped is skipped.
+ */
+template <std::size_t N>
+class slow_ring
+{
+private:
+  struct slot
+  {
+    std::atomic<std::uint64_t> seq{0};
+    std::atomic<int> fd{-1};
+    std::atomic<std::int64_t> duration{0};
+    std::atomic<std::int64_t> at{0};
+  };
+
+public:
+  void
+  push(int fd, std::chrono::nanoseconds duration, clock::time_point at)
+  {
+    auto i = head_.load(std::memory_order_relaxed);
+    auto & s = slots_[ i % N ];
+
+    s.seq.store(2 * i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    s.fd.store(fd, std::memory_order_relaxed);
+    s.duration.store(duration.count(), std::memory_order_relaxed);
+    s.at.store(at.time_since_epoch().count(), std::memory_order_relaxed);
+
+    s.seq.store(2 * i + 2, std::memory_order_release);
+    head_.store(i + 1, std::memory_order_release);
+  }
+
+  /**
+   * @brief Call f on every consistent entry, oldest first
+   */
+  template <typename F>
+  void
+  dump(F f) const
+  {
+    auto head = head_.load(std::memory_order_acquire);
+
+    for (auto i = head > N ? head - N : 0; i < head; ++i)
+    {
+      auto const & s = slots_[ i % N ];
+
+      auto seq = s.seq.load(std::memory_order_acquire);
+      if (seq != 2 * i + 2)
+        continue;
+
+      slow_t e{s.fd.load(std::memory_order_relaxed),
+               std::chrono::nanoseconds(s.duration.load(std::memory_order_relaxed)),
+               clock::time_point(clock::duration(s.at.load(std::memory_order_relaxed)))};
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (s.seq.load(std::memory_order_relaxed) != seq)
+        continue;
+
+      f(e);
+    }
+  }
+
+  std::uint64_t
+  total() const
+  {
+    return head_.load(std::memory_order_acquire);
+  }
+
+private:
+  std::array<slot, N> slots_;
+  std::atomic<std::uint64_t> head_{0};
+};
+
+/**
+ * @brief Default event loop instrumentation: nothing is measured, nothing is compiled in
+ */
+struct none
+{
+  static constexpr bool enabled = false;
+
+  void
+  on_wait(int)
+  {
+  }
+
+  void
+  on_lag(clock::duration)
+  {
+  }
+
+  void
+  on_handler(int, clock::duration, clock::time_point)
+  {
+  }
+
+  void
+  on_timer(int, clock::duration)
+  {
+  }
+};
+
+/**
+ * @brief Event loop instrumentation
+ *
+ * - batches: events returned per wait
+ * - lag: time from the wait returning to the handler being called
+ * - lateness: timer expirations against their deadline
+ * - handlers: time spent per tag (the fd unless tagged), only read from the loop thread
+ * - slow: handlers above the slow threshold
+ */
+template <std::size_t SLOW = 256>
+class recorder
+{
+public:
+  static constexpr bool enabled = true;
+
+  struct handler_t
+  {
+    std::uint64_t calls;
+    clock::duration total;
+    clock::duration max;
+  };
+
+public:
+  recorder() : slow_threshold_(std::chrono::milliseconds(1)) {}
+
+public:
+  void
+  on_wait(int n)
+  {
+    batches.add(static_cast<std::uint64_t>(n < 0 ? 0 : n));
+  }
+
+  void
+  on_lag(clock::duration d)
+  {
+    lag.add(d);
+  }
+
+  void
+  on_handler(int fd, clock::duration d, clock::time_point at)
+  {
+    auto t = tags_.find(fd);
+    auto & h = handlers_[ t == tags_.end() ? fd : t->second ];
+
+    h.calls++;
+    h.total += d;
+    if (d > h.max)
+      h.max = d;
+
+    if (d >= slow_threshold_)
+      slow.push(fd, d, at);
+  }
+
+  void
+  on_timer(int, clock::duration late)
+  {
+    lateness.add(late);
+  }
+
+public:
+  /**
+   * @brief Aggregate the handler time of fd under tag
+   */
+  void
+  tag(int fd, int tag)
+  {
+    tags_[ fd ] = tag;
+  }
+
+  template <typename P, typename R>
+  void
+  slow_threshold(std::chrono::duration<P, R> dur)
+  {
+    slow_threshold_ = std::chrono::duration_cast<clock::duration>(dur);
+  }
+
+  std::unordered_map<int, handler_t> const &
+  handlers() const
+  {
+    return handlers_;
+  }
+
+public:
+  histogram batches;
+  histogram lag;
+  histogram lateness;
+  slow_ring<SLOW> slow;
+
+private:
+  clock::duration slow_threshold_;
+
+  std::unordered_map<int, int> tags_;
+  std::unordered_map<int, handler_t> handlers_;
+};
+
+} /** !stats */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_STATS_HH_ */
@@ -5,74 +5,61 @@
 #ifndef BOKASAFN_TIMER_HH_
 # define BOKASAFN_TIMER_HH_
 
-# include <atomic>
-# include <thread>
+# include <chrono>
+
+# include <bokasafn/scheduler.hh>
 
 namespace bokasafn {
 
 /**
- * @brief 
+ * @brief One timer at a time on a shared scheduler, no thread per call
+ *
+ * Arming the timer again cancels the previous one.
  */
 class timer
 {
   public:
-    timer(): clear_(false) { }
+    timer(scheduler & s = scheduler::instance()): scheduler_(s) { }
+
+    ~timer()
+    {
+      stop();
+    }
+
+    timer(timer const &) = delete;
+    timer & operator=(timer const &) = delete;
 
   public:
     template <typename F>
     void timeout(int delay, F f)
     {
-      clear_ = false;
-
-      thread_ = std::thread([=]()
-      {
-        if(this->clear_)
-          return;
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
-
-        if(this->clear_)
-          return;
-
-        f();
-      });
+      handle_.cancel();
+      handle_ = scheduler_.after(std::chrono::milliseconds(delay), f);
     }
 
     template <typename F>
     void interval(int interval, F f)
     {
-      clear_ = false;
-
-      thread_ = std::thread([=]()
-      {
-        while (true)
-        {
-          if(this->clear_)
-            return;
-
-          std::this_thread::sleep_for(std::chrono::milliseconds(interval));
-
-          if(this->clear_)
-            return;
-
-          f();
-        }
-      });
+      handle_.cancel();
+      handle_ = scheduler_.every(std::chrono::milliseconds(interval), f);
     }
 
     void stop()
     {
-      clear_ = true;
+      handle_.cancel();
     }
 
+    /**
+     * @brief Block until the timeout fired, or until the stopped interval is idle
+     */
     void wait()
     {
-      thread_.join();
+      handle_.wait();
     }
 
   private:
-    std::atomic<bool> clear_;
-    std::thread thread_;
+    scheduler & scheduler_;
+    scheduler::handle handle_;
 };
 
 } /** !bokasafn */
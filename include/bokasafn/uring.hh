@@ -0,0 +1,730 @@
+/**
+ *  @file uring.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_URING_HH_
+#define BOKASAFN_URING_HH_
+
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <unordered_map>
+
+#include <bokasafn/exceptions.hh>
+
+namespace bokasafn
+{
+
+/**
+ * @brief io_uring event loop exposing the same handler and timer API as bokasafn::epoll
+ *
+ * Readiness handlers are oneshot polls re-armed when the handler returns true, timers are
+ * IORING_OP_TIMEOUT requests. Every request queued during an iteration is submitted by the
+ * single io_uring_enter() that also waits for the next completions.
+ *
+ * On top of the epoll API, recv() and accept() arm multishot requests: recv() hands out
+ * payloads from a buffer group provided to the kernel, so a readable socket costs no extra
+ * syscall. Buffers are given back with the next batch once the handler returns.
+ *
+ * Timer identifiers are negative so they never collide with file descriptors.
+ */
+template <std::size_t MAX_EVENTS, std::size_t BUFFERS = 256, std::size_t BUFFER_SIZE = 2048>
+class uring
+{
+  static_assert(BUFFERS && BUFFERS <= 65536, "buffer ids are 16 bits");
+
+public:
+  using func_t = std::function<bool(int)>;
+  using recv_func_t = std::function<bool(int, void const *, std::size_t)>;
+  using accept_func_t = std::function<bool(int, int)>;
+
+private:
+  enum class op_t : std::uint8_t
+  {
+    poll = 1,
+    timer,
+    recv,
+    accept,
+    internal,
+  };
+
+  struct fd_handler_t
+  {
+    std::uint32_t gen;
+    std::uint32_t events;
+    std::list<std::pair<int, func_t>> funcs;
+
+    template <typename... Args>
+    bool
+    call(int events, Args &&... args)
+    {
+      bool again = false;
+
+      for (auto const & it : funcs)
+      {
+        if (events & it.first)
+        {
+          again |= it.second(std::forward<Args>(args)...);
+
+          if (!again)
+            return again;
+        }
+      }
+
+      return again;
+    }
+
+    void
+    add(int events, func_t f)
+    {
+      this->events |= events;
+
+      funcs.push_back({events, f});
+    }
+  };
+
+  struct timer_handler_t
+  {
+    std::uint32_t gen;
+    __kernel_timespec ts;
+    func_t f;
+  };
+
+  struct stream_handler_t
+  {
+    op_t type;
+    std::uint32_t gen;
+    recv_func_t recv;
+    accept_func_t accept;
+  };
+
+public:
+  uring() : running_(false), dispatching_(-1), gen_(0), timer_seq_(0), buf_data_(nullptr)
+  {
+    io_uring_params p;
+
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CLAMP | IORING_SETUP_COOP_TASKRUN;
+
+    fd_ = syscall(__NR_io_uring_setup, MAX_EVENTS, &p);
+    if (fd_ < 0 && errno == EINVAL)
+    {
+      // Kernel older than 5.19
+      memset(&p, 0, sizeof(p));
+      p.flags = IORING_SETUP_CLAMP;
+
+      fd_ = syscall(__NR_io_uring_setup, MAX_EVENTS, &p);
+    }
+    if (fd_ < 0)
+      throw bokasafn::exceptions::perror("io_uring_setup");
+
+    if (!(p.features & IORING_FEAT_EXT_ARG))
+    {
+      ::close(fd_);
+      errno = ENOSYS;
+      throw bokasafn::exceptions::perror("io_uring_setup(EXT_ARG)");
+    }
+
+    sq_size_ = p.sq_off.array + p.sq_entries * sizeof(std::uint32_t);
+    cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+
+    sq_ptr_ = map(sq_size_, IORING_OFF_SQ_RING);
+    cq_ptr_ = (p.features & IORING_FEAT_SINGLE_MMAP) ? sq_ptr_ : map(cq_size_, IORING_OFF_CQ_RING);
+
+    sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe *>(map(sqes_size_, IORING_OFF_SQES));
+
+    auto sq = static_cast<char *>(sq_ptr_);
+    sq_khead_ = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+    sq_ktail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+    sq_entries_ = p.sq_entries;
+    sq_tail_ = *sq_ktail_;
+
+    // SQE indirection array is the identity, slots are used in ring order
+    auto array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; ++i)
+      array[ i ] = i;
+
+    auto cq = static_cast<char *>(cq_ptr_);
+    cq_khead_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+    cq_ktail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+  }
+
+  ~uring()
+  {
+    if (buf_data_)
+      munmap(buf_data_, BUFFERS * BUFFER_SIZE);
+
+    munmap(sqes_, sqes_size_);
+    if (cq_ptr_ != sq_ptr_)
+      munmap(cq_ptr_, cq_size_);
+    munmap(sq_ptr_, sq_size_);
+
+    ::close(fd_);
+  }
+
+  uring(uring const &) = delete;
+  uring &
+  operator=(uring const &) = delete;
+
+public:
+  template <typename P, typename R>
+  void
+  start(std::chrono::duration<P, R> dur)
+  {
+    auto timeout = to_timespec(dur);
+
+    running_ = true;
+
+    while (running_)
+    {
+      enter(1, &timeout);
+
+      std::array<io_uring_cqe, MAX_EVENTS> cqes;
+      std::size_t n = 0;
+
+      do
+      {
+        n = reap(cqes);
+
+        for (std::size_t i = 0; i < n; ++i)
+          dispatch(cqes[ i ]);
+      } while (n == MAX_EVENTS);
+    }
+  }
+
+  void
+  stop()
+  {
+    running_ = false;
+  }
+
+public:
+  int
+  add(int fd, func_t f, int flags = EPOLLIN)
+  {
+    auto it = handlers_.find(fd);
+
+    if (it == handlers_.end())
+    {
+      fd_handler_t handle{++gen_, 0, {}};
+      handle.add(flags, f);
+
+      auto & h = handlers_.emplace(fd, handle).first->second;
+
+      arm_poll(fd, h);
+    }
+    else
+    {
+      // Widen the pending poll: cancel it and queue a new one with the full mask
+      queue_cancel(IORING_OP_POLL_REMOVE, encode(op_t::poll, it->second.gen, fd));
+
+      it->second.gen = ++gen_;
+      it->second.add(flags, f);
+
+      arm_poll(fd, it->second);
+    }
+
+    return fd;
+  }
+
+  /**
+   * @brief Replace the events fd is polled for
+   *
+   * Called from the fd handler itself, the new mask is applied when the handler returns.
+   */
+  void
+  modify(int fd, int flags)
+  {
+    auto it = handlers_.find(fd);
+    if (it == handlers_.end())
+      return;
+
+    it->second.events = flags;
+
+    if (fd == dispatching_)
+      return;
+
+    queue_cancel(IORING_OP_POLL_REMOVE, encode(op_t::poll, it->second.gen, fd));
+
+    it->second.gen = ++gen_;
+    arm_poll(fd, it->second);
+  }
+
+  void
+  remove(int fd)
+  {
+    if (fd < 0)
+    {
+      auto it = timers_.find(fd);
+      if (it == timers_.end())
+        return;
+
+      queue_cancel(IORING_OP_TIMEOUT_REMOVE, encode(op_t::timer, it->second.gen, fd));
+      timers_.erase(it);
+
+      return;
+    }
+
+    auto it = handlers_.find(fd);
+    if (it != handlers_.end())
+    {
+      queue_cancel(IORING_OP_POLL_REMOVE, encode(op_t::poll, it->second.gen, fd));
+      handlers_.erase(it);
+    }
+
+    auto st = streams_.find(fd);
+    if (st != streams_.end())
+    {
+      queue_cancel(IORING_OP_ASYNC_CANCEL, encode(st->second.type, st->second.gen, fd));
+      streams_.erase(st);
+    }
+  }
+
+public:
+  template <typename P, typename R>
+  int
+  timer(std::chrono::duration<P, R> dur, func_t f)
+  {
+    int id = --timer_seq_;
+
+    auto & t = timers_[ id ];
+    t.gen = ++gen_;
+    t.ts = to_timespec(dur);
+    t.f = f;
+
+    arm_timer(id, t);
+
+    return id;
+  }
+
+  /**
+   * @brief Arm a multishot recv on fd
+   *
+   * f is called with each payload, or with a null payload on EOF or error. The payload
+   * buffer goes back to the kernel as soon as f returns.
+   */
+  int
+  recv(int fd, recv_func_t f)
+  {
+    setup_buffers();
+
+    auto & s = streams_[ fd ];
+    s.type = op_t::recv;
+    s.gen = ++gen_;
+    s.recv = f;
+
+    arm_recv(fd, s);
+
+    return fd;
+  }
+
+  /**
+   * @brief Arm a multishot accept on fd
+   *
+   * Accepted descriptors are already SOCK_NONBLOCK | SOCK_CLOEXEC.
+   */
+  int
+  accept(int fd, accept_func_t f)
+  {
+    auto & s = streams_[ fd ];
+    s.type = op_t::accept;
+    s.gen = ++gen_;
+    s.accept = f;
+
+    arm_accept(fd, s);
+
+    return fd;
+  }
+
+private:
+  static constexpr __kernel_timespec
+  to_timespec(std::chrono::nanoseconds dur)
+  {
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(dur);
+    dur -= secs;
+
+    return __kernel_timespec{secs.count(), dur.count()};
+  }
+
+  static constexpr std::uint64_t
+  encode(op_t op, std::uint32_t gen, int key)
+  {
+    return (std::uint64_t(op) << 56) | (std::uint64_t(gen & 0xffffff) << 32) |
+           std::uint32_t(key);
+  }
+
+  void *
+  map(std::size_t size, off_t offset)
+  {
+    void * ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+    if (ptr == MAP_FAILED)
+      throw bokasafn::exceptions::perror("mmap(io_uring)");
+
+    return ptr;
+  }
+
+  void
+  setup_buffers()
+  {
+    if (buf_data_)
+      return;
+
+    void * data = mmap(nullptr,
+                       BUFFERS * BUFFER_SIZE,
+                       PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+                       -1,
+                       0);
+    if (data == MAP_FAILED)
+      throw bokasafn::exceptions::perror("mmap(buffers)");
+
+    buf_data_ = static_cast<char *>(data);
+
+    provide(0, BUFFERS);
+  }
+
+  void
+  provide(std::size_t bid, std::size_t count)
+  {
+    auto sqe = get_sqe();
+
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = count;
+    sqe->addr = reinterpret_cast<std::uint64_t>(buf_data_ + bid * BUFFER_SIZE);
+    sqe->len = BUFFER_SIZE;
+    sqe->off = bid;
+    sqe->buf_group = 0;
+    sqe->user_data = encode(op_t::internal, 0, 0);
+  }
+
+private:
+  io_uring_sqe *
+  get_sqe()
+  {
+    if (sq_tail_ - __atomic_load_n(sq_khead_, __ATOMIC_ACQUIRE) >= sq_entries_)
+      enter(0, nullptr);
+
+    if (sq_tail_ - __atomic_load_n(sq_khead_, __ATOMIC_ACQUIRE) >= sq_entries_)
+    {
+      errno = EBUSY;
+      throw bokasafn::exceptions::perror("io_uring(SQ full)");
+    }
+
+    io_uring_sqe * sqe = &sqes_[ sq_tail_ & sq_mask_ ];
+    memset(sqe, 0, sizeof(*sqe));
+
+    ++sq_tail_;
+
+    return sqe;
+  }
+
+  void
+  enter(unsigned wait, __kernel_timespec * timeout)
+  {
+    __atomic_store_n(sq_ktail_, sq_tail_, __ATOMIC_RELEASE);
+
+    unsigned to_submit = sq_tail_ - __atomic_load_n(sq_khead_, __ATOMIC_ACQUIRE);
+    unsigned flags = 0;
+
+    io_uring_getevents_arg arg;
+
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<std::uint64_t>(timeout);
+
+    if (wait)
+      flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+
+    if (!to_submit && !wait)
+      return;
+
+    auto ret = syscall(__NR_io_uring_enter, fd_, to_submit, wait, flags, &arg, sizeof(arg));
+    if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+      throw bokasafn::exceptions::perror("io_uring_enter");
+  }
+
+  std::size_t
+  reap(std::array<io_uring_cqe, MAX_EVENTS> & cqes)
+  {
+    unsigned head = *cq_khead_;
+    unsigned tail = __atomic_load_n(cq_ktail_, __ATOMIC_ACQUIRE);
+    std::size_t n = 0;
+
+    while (head != tail && n < MAX_EVENTS)
+      cqes[ n++ ] = cqes_[ head++ & cq_mask_ ];
+
+    __atomic_store_n(cq_khead_, head, __ATOMIC_RELEASE);
+
+    return n;
+  }
+
+  void
+  arm_poll(int fd, fd_handler_t const & h)
+  {
+    auto sqe = get_sqe();
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = h.events;
+    sqe->user_data = encode(op_t::poll, h.gen, fd);
+  }
+
+  void
+  arm_timer(int id, timer_handler_t & t)
+  {
+    auto sqe = get_sqe();
+
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<std::uint64_t>(&t.ts);
+    sqe->len = 1;
+    sqe->user_data = encode(op_t::timer, t.gen, id);
+  }
+
+  void
+  arm_recv(int fd, stream_handler_t const & s)
+  {
+    auto sqe = get_sqe();
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = encode(op_t::recv, s.gen, fd);
+  }
+
+  void
+  arm_accept(int fd, stream_handler_t const & s)
+  {
+    auto sqe = get_sqe();
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = encode(op_t::accept, s.gen, fd);
+  }
+
+  void
+  queue_cancel(std::uint8_t opcode, std::uint64_t target)
+  {
+    auto sqe = get_sqe();
+
+    sqe->opcode = opcode;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = encode(op_t::internal, 0, 0);
+  }
+
+private:
+  void
+  dispatch(io_uring_cqe const & cqe)
+  {
+    auto op = static_cast<op_t>(cqe.user_data >> 56);
+    auto gen = static_cast<std::uint32_t>(cqe.user_data >> 32) & 0xffffff;
+    auto key = static_cast<int>(cqe.user_data & 0xffffffff);
+
+    switch (op)
+    {
+      case op_t::poll:
+        on_poll(key, gen, cqe);
+        break;
+      case op_t::timer:
+        on_timer(key, gen, cqe);
+        break;
+      case op_t::recv:
+        on_recv(key, gen, cqe);
+        break;
+      case op_t::accept:
+        on_accept(key, gen, cqe);
+        break;
+      default:
+        break;
+    }
+  }
+
+  void
+  on_poll(int fd, std::uint32_t gen, io_uring_cqe const & cqe)
+  {
+    auto it = handlers_.find(fd);
+    if (it == handlers_.end() || (it->second.gen & 0xffffff) != gen || cqe.res == -ECANCELED)
+      return;
+
+    int events = cqe.res < 0 ? int(EPOLLERR) : cqe.res;
+
+    dispatching_ = fd;
+    bool again = it->second.call(events, fd);
+    dispatching_ = -1;
+
+    // The handler may have removed or replaced itself
+    it = handlers_.find(fd);
+    if (it == handlers_.end() || (it->second.gen & 0xffffff) != gen)
+      return;
+
+    if (again)
+      arm_poll(fd, it->second);
+    else
+      handlers_.erase(it);
+  }
+
+  void
+  on_timer(int id, std::uint32_t gen, io_uring_cqe const & cqe)
+  {
+    auto it = timers_.find(id);
+    if (it == timers_.end() || (it->second.gen & 0xffffff) != gen || cqe.res != -ETIME)
+      return;
+
+    bool again = it->second.f(id);
+
+    it = timers_.find(id);
+    if (it == timers_.end() || (it->second.gen & 0xffffff) != gen)
+      return;
+
+    if (again)
+      arm_timer(id, it->second);
+    else
+      timers_.erase(it);
+  }
+
+  void
+  on_recv(int fd, std::uint32_t gen, io_uring_cqe const & cqe)
+  {
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+    bool again = true;
+
+    auto it = streams_.find(fd);
+    bool live = it != streams_.end() && (it->second.gen & 0xffffff) == gen;
+
+    if (cqe.flags & IORING_CQE_F_BUFFER)
+    {
+      std::size_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+
+      if (live)
+        again = it->second.recv(fd, buf_data_ + bid * BUFFER_SIZE, cqe.res);
+
+      provide(bid, 1);
+    }
+    else if (cqe.res == -ENOBUFS)
+    {
+      // Buffer group drained, payloads are given back so simply re-arm
+    }
+    else if (live)
+    {
+      // EOF or error
+      it->second.recv(fd, nullptr, 0);
+      again = false;
+    }
+
+    if (!live)
+      return;
+
+    it = streams_.find(fd);
+    if (it == streams_.end() || (it->second.gen & 0xffffff) != gen)
+      return;
+
+    if (!again)
+    {
+      if (more)
+        queue_cancel(IORING_OP_ASYNC_CANCEL, cqe.user_data);
+
+      streams_.erase(it);
+    }
+    else if (!more)
+    {
+      it->second.gen = ++gen_;
+      arm_recv(fd, it->second);
+    }
+  }
+
+  void
+  on_accept(int fd, std::uint32_t gen, io_uring_cqe const & cqe)
+  {
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+
+    auto it = streams_.find(fd);
+    if (it == streams_.end() || (it->second.gen & 0xffffff) != gen)
+    {
+      if (cqe.res >= 0)
+        ::close(cqe.res);
+      return;
+    }
+
+    bool again = true;
+
+    if (cqe.res >= 0)
+      again = it->second.accept(fd, cqe.res);
+    else if (cqe.res != -ECONNABORTED && cqe.res != -EINTR)
+      again = false;
+
+    it = streams_.find(fd);
+    if (it == streams_.end() || (it->second.gen & 0xffffff) != gen)
+      return;
+
+    if (!again)
+    {
+      if (more)
+        queue_cancel(IORING_OP_ASYNC_CANCEL, cqe.user_data);
+
+      streams_.erase(it);
+    }
+    else if (!more)
+    {
+      it->second.gen = ++gen_;
+      arm_accept(fd, it->second);
+    }
+  }
+
+private:
+  bool running_;
+  int fd_;
+  int dispatching_;
+
+  std::uint32_t gen_;
+  int timer_seq_;
+
+  void * sq_ptr_;
+  void * cq_ptr_;
+  std::size_t sq_size_;
+  std::size_t cq_size_;
+
+  io_uring_sqe * sqes_;
+  std::size_t sqes_size_;
+  unsigned * sq_khead_;
+  unsigned * sq_ktail_;
+  unsigned sq_mask_;
+  unsigned sq_entries_;
+  unsigned sq_tail_;
+
+  unsigned * cq_khead_;
+  unsigned * cq_ktail_;
+  unsigned cq_mask_;
+  io_uring_cqe * cqes_;
+
+  char * buf_data_;
+
+  std::unordered_map<int, fd_handler_t> handlers_;
+  std::unordered_map<int, timer_handler_t> timers_;
+  std::unordered_map<int, stream_handler_t> streams_;
+};
+
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_URING_HH_ */
@@ -0,0 +1,156 @@
+/**
+ *  @file ring.hh
+ *  @author Olivier Détour (detour.olivier@gmail.com)
+ */
+#ifndef BOKASAFN_UTILS_RING_HH_
+#define BOKASAFN_UTILS_RING_HH_
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <bokasafn/exceptions.hh>
+
+namespace bokasafn
+{
+namespace utils
+{
+
+/**
+ * @brief Byte ring mapped twice back to back, so both free and used bytes are contiguous
+ *
+ * The same memfd pages are mapped at base and at base + capacity: a read or a write running
+ * past the end continues at the start. Single threaded.
+ */
+class mirrored_ring
+{
+public:
+  /**
+   * @param capacity rounded up to the page size
+   */
+  explicit mirrored_ring(std::size_t capacity) : head_(0), tail_(0)
+  {
+    auto page = std::size_t(sysconf(_SC_PAGESIZE));
+    capacity_ = (capacity + page - 1) / page * page;
+
+    int fd = memfd_create("bokasafn-ring", MFD_CLOEXEC);
+    if (fd < 0)
+      throw bokasafn::exceptions::perror("memfd_create");
+
+    if (ftruncate(fd, off_t(capacity_)) < 0)
+    {
+      ::close(fd);
+      throw bokasafn::exceptions::perror("ftruncate");
+    }
+
+    // Reserve both halves at once, then map the file over each
+    auto base = mmap(nullptr, 2 * capacity_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+    {
+      ::close(fd);
+      throw bokasafn::exceptions::perror("mmap");
+    }
+
+    base_ = static_cast<char *>(base);
+
+    for (int i = 0; i < 2; ++i)
+    {
+      if (mmap(base_ + i * capacity_, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+      {
+        ::close(fd);
+        munmap(base_, 2 * capacity_);
+        throw bokasafn::exceptions::perror("mmap");
+      }
+    }
+
+    ::close(fd);
+  }
+
+  ~mirrored_ring()
+  {
+    if (base_)
+      munmap(base_, 2 * capacity_);
+  }
+
+  mirrored_ring(mirrored_ring && other) noexcept
+    : base_(std::exchange(other.base_, nullptr)), capacity_(other.capacity_), head_(other.head_), tail_(other.tail_)
+  {
+  }
+
+  mirrored_ring(mirrored_ring const &) = delete;
+  mirrored_ring &
+  operator=(mirrored_ring const &) = delete;
+
+public:
+  /**
+   * @brief Bytes to read, size() of them
+   */
+  char const *
+  data() const
+  {
+    return base_ + head_ % capacity_;
+  }
+
+  std::size_t
+  size() const
+  {
+    return std::size_t(tail_ - head_);
+  }
+
+  void
+  consume(std::size_t n)
+  {
+    head_ += n;
+
+    // Back to the start when empty, large writes find the whole ring
+    if (head_ == tail_)
+      head_ = tail_ = 0;
+  }
+
+  /**
+   * @brief Room to write into, space() bytes of it
+   */
+  char *
+  room()
+  {
+    return base_ + tail_ % capacity_;
+  }
+
+  std::size_t
+  space() const
+  {
+    return capacity_ - size();
+  }
+
+  void
+  commit(std::size_t n)
+  {
+    tail_ += n;
+  }
+
+  std::size_t
+  capacity() const
+  {
+    return capacity_;
+  }
+
+  bool
+  empty() const
+  {
+    return head_ == tail_;
+  }
+
+private:
+  char * base_;
+  std::size_t capacity_;
+  std::uint64_t head_;
+  std::uint64_t tail_;
+};
+
+} /** !utils */
+} /** !bokasafn */
+
+#endif /** !BOKASAFN_UTILS_RING_HH_ */
@@ -5,8 +5,15 @@
 #ifndef BOKASAFN_UTILS_SIGNAL_HH_
 #define BOKASAFN_UTILS_SIGNAL_HH_
 
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+#include <cerrno>
 #include <csignal>
 #include <functional>
+#include <initializer_list>
+
+#include <bokasafn/exceptions.hh>
 
 namespace bokasafn
 {
@@ -42,6 +49,150 @@ struct signal_handler
   }
 };
 
+/**
+ * @brief Signals delivered through a signalfd as regular event loop events
+ *
+ * A signal mask is per thread: the constructor only blocks the signals in the calling thread, and
+ * a thread that already runs still gets the default action when the kernel picks it. In a
+ * multithreaded program, call block() from main before starting any thread so that every thread
+ * inherits the mask. Handlers run on the loop thread, once per wakeup and per signal with the
+ * number of occurrences coalesced.
+ */
+class signal_source
+{
+public:
+  using fx_t = std::function<void(signalfd_siginfo const &, unsigned)>;
+
+  static constexpr int MAX_SIGNALS = 65;
+
+public:
+  signal_source(std::initializer_list<int> signals)
+  {
+    sigemptyset(&mask_);
+    for (auto s : signals)
+      sigaddset(&mask_, s);
+
+    if (pthread_sigmask(SIG_BLOCK, &mask_, &old_))
+      throw bokasafn::exceptions::perror("pthread_sigmask");
+
+    fd_ = signalfd(-1, &mask_, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd_ < 0)
+    {
+      int err = errno;
+      pthread_sigmask(SIG_SETMASK, &old_, nullptr);
+      errno = err;
+      throw bokasafn::exceptions::perror("signalfd");
+    }
+  }
+
+  /**
+   * @brief Block signals in the calling thread and in every thread it starts afterwards
+   *
+   * Call it before any thread exists so the block is process-wide. The signals stay blocked
+   * after a signal_source is destroyed.
+   */
+  static void
+  block(std::initializer_list<int> signals)
+  {
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (auto s : signals)
+      sigaddset(&mask, s);
+
+    if (pthread_sigmask(SIG_BLOCK, &mask, nullptr))
+      throw bokasafn::exceptions::perror("pthread_sigmask");
+  }
+
+  /**
+   * @brief Signals still pending are discarded, not delivered with their default action
+   */
+  ~signal_source()
+  {
+    signalfd_siginfo infos[ 16 ];
+    while (::read(fd_, infos, sizeof(infos)) > 0)
+      ;
+
+    ::close(fd_);
+    pthread_sigmask(SIG_SETMASK, &old_, nullptr);
+  }
+
+  signal_source(signal_source const &) = delete;
+  signal_source &
+  operator=(signal_source const &) = delete;
+
+public:
+  void
+  on(int sn, fx_t fx)
+  {
+    if (sn <= 0 || sn >= MAX_SIGNALS)
+    {
+      errno = EINVAL;
+      throw bokasafn::exceptions::perror("signal_source");
+    }
+
+    fxs_[ sn ] = fx;
+  }
+
+  /**
+   * @brief Register on an event loop (bokasafn::epoll or bokasafn::uring)
+   */
+  template <typename E>
+  void
+  attach(E & e)
+  {
+    e.add(fd_, [this](int) {
+      dispatch();
+      return true;
+    });
+  }
+
+  /**
+   * @brief Drain every pending signal, then call each handler once
+   */
+  void
+  dispatch()
+  {
+    signalfd_siginfo infos[ 16 ];
+    signalfd_siginfo last[ MAX_SIGNALS ];
+    unsigned counts[ MAX_SIGNALS ] = {};
+
+    for (;;)
+    {
+      auto n = ::read(fd_, infos, sizeof(infos));
+      if (n <= 0)
+        break;
+
+      for (std::size_t i = 0; i < n / sizeof(signalfd_siginfo); ++i)
+      {
+        auto sn = infos[ i ].ssi_signo;
+        if (sn >= MAX_SIGNALS)
+          continue;
+
+        last[ sn ] = infos[ i ];
+        counts[ sn ]++;
+      }
+    }
+
+    for (int sn = 1; sn < MAX_SIGNALS; ++sn)
+    {
+      if (counts[ sn ] && fxs_[ sn ])
+        fxs_[ sn ](last[ sn ], counts[ sn ]);
+    }
+  }
+
+  int
+  fd() const
+  {
+    return fd_;
+  }
+
+private:
+  int fd_;
+  sigset_t mask_;
+  sigset_t old_;
+  fx_t fxs_[ MAX_SIGNALS ];
+};
+
 } // namespace utils
 } // namespace bokasafn
 
@@ -0,0 +1,179 @@
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <bokasafn/coro/loop.hh>
+#include <bokasafn/coro/socket.hh>
+#include <bokasafn/epoll.hh>
+#include <bokasafn/net/socket.hh>
+
+using namespace std::literals::chrono_literals;
+
+using bokasafn::coro::task;
+using loop_t = bokasafn::coro::loop<bokasafn::epoll<20>>;
+
+TEST(TestCoroLoop, Sleep)
+{
+  bokasafn::epoll<20> e;
+  loop_t l(e);
+  std::vector<int> order;
+
+  auto sleeper = [](loop_t & l, std::vector<int> & order, int id, auto dur) -> task<> {
+    co_await l.sleep(dur);
+    order.push_back(id);
+  };
+
+  bokasafn::coro::spawn(sleeper(l, order, 2, 100ms));
+  bokasafn::coro::spawn(sleeper(l, order, 1, 50ms));
+  bokasafn::coro::spawn([](loop_t & l, bokasafn::epoll<20> & e) -> task<> {
+    co_await l.sleep(200ms);
+    e.stop();
+  }(l, e));
+
+  e.start(500ms);
+
+  EXPECT_EQ(order, (std::vector<int>{1, 2}));
+}
+
+TEST(TestCoroLoop, Readable)
+{
+  int p[ 2 ];
+  EXPECT_EQ(pipe(p), 0);
+
+  bokasafn::epoll<20> e;
+  loop_t l(e);
+  int total = 0;
+
+  bokasafn::coro::spawn([](loop_t & l, bokasafn::epoll<20> & e, int fd, int & total) -> task<> {
+    while (total < 3)
+    {
+      co_await l.readable(fd);
+
+      char c;
+      total += read(fd, &c, 1);
+    }
+
+    e.stop();
+  }(l, e, p[ 0 ], total));
+
+  bokasafn::coro::spawn([](loop_t & l, int fd) -> task<> {
+    for (int i = 0; i < 3; ++i)
+    {
+      co_await l.sleep(20ms);
+      EXPECT_EQ(write(fd, "a", 1), 1);
+    }
+  }(l, p[ 1 ]));
+
+  e.start(500ms);
+
+  close(p[ 0 ]);
+  close(p[ 1 ]);
+
+  EXPECT_EQ(total, 3);
+}
+
+TEST(TestCoroLoop, SocketEcho)
+{
+  using tcp = bokasafn::net::ipv4::tcp;
+  using socket_t = bokasafn::coro::socket<bokasafn::epoll<20>, tcp>;
+
+  bokasafn::epoll<20> e;
+  loop_t l(e);
+
+  tcp s;
+  s.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  s.bind({"127.0.0.1", 12348});
+  s.listen(3);
+
+  int input = 0;
+
+  bokasafn::coro::spawn([](loop_t & l, tcp & s) -> task<> {
+    socket_t server(l, s);
+    bokasafn::net::saddr peer;
+
+    auto p = co_await server.async_accept(peer);
+    socket_t conn(l, p);
+
+    int data;
+    co_await conn.async_recv(&data, sizeof(data));
+    co_await conn.async_send(&data, sizeof(data));
+  }(l, s));
+
+  tcp c;
+  c.connect({"127.0.0.1", 12348});
+
+  bokasafn::coro::spawn([](loop_t & l, bokasafn::epoll<20> & e, tcp & c, int & input) -> task<> {
+    socket_t client(l, c);
+
+    int data = 42;
+    co_await client.async_send(&data, sizeof(data));
+    co_await client.async_recv(&input, sizeof(input));
+
+    e.stop();
+  }(l, e, c, input));
+
+  e.start(500ms);
+
+  EXPECT_EQ(input, 42);
+}
+
+TEST(TestCoroLoop, Directions)
+{
+  int p[ 2 ];
+  EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, p), 0);
+
+  bokasafn::epoll<20> e;
+  loop_t l(e);
+  int woken = 0;
+  bool busy = false;
+
+  auto reader = [](loop_t & l, int fd, int & woken) -> task<> {
+    co_await l.readable(fd);
+    woken++;
+
+    char c;
+    EXPECT_EQ(read(fd, &c, 1), 1);
+  };
+
+  bokasafn::coro::spawn(reader(l, p[ 0 ], woken));
+
+  // Only one reader per descriptor
+  bokasafn::coro::spawn([](loop_t & l, int fd, bool & busy) -> task<> {
+    try
+    {
+      co_await l.readable(fd);
+    }
+    catch (bokasafn::exceptions::perror const & e)
+    {
+      busy = std::string(e.what()) == std::string("readable: ") + std::strerror(EBUSY);
+    }
+  }(l, p[ 0 ], busy));
+
+  EXPECT_TRUE(busy);
+
+  // Writable at once, the reader must stay asleep
+  bokasafn::coro::spawn([](loop_t & l, bokasafn::epoll<20> & e, int fd, int & woken) -> task<> {
+    co_await l.writable(fd);
+    EXPECT_EQ(woken, 0);
+
+    co_await l.sleep(20ms);
+    EXPECT_EQ(woken, 0);
+
+    e.stop();
+  }(l, e, p[ 0 ], woken));
+
+  e.start(500ms);
+  EXPECT_EQ(woken, 0);
+
+  EXPECT_EQ(write(p[ 1 ], "a", 1), 1);
+  bokasafn::coro::spawn([](loop_t & l, bokasafn::epoll<20> & e) -> task<> {
+    co_await l.sleep(20ms);
+    e.stop();
+  }(l, e));
+  e.start(500ms);
+
+  EXPECT_EQ(woken, 1);
+
+  close(p[ 0 ]);
+  close(p[ 1 ]);
+}
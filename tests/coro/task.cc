@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+#include <bokasafn/coro/task.hh>
+
+using bokasafn::coro::task;
+
+namespace
+{
+
+task<int>
+answer()
+{
+  co_return 42;
+}
+
+task<int>
+twice()
+{
+  auto a = co_await answer();
+  auto b = co_await answer();
+
+  co_return a + b;
+}
+
+task<int>
+fail()
+{
+  throw std::runtime_error("fail");
+  co_return 0;
+}
+
+} // namespace
+
+TEST(TestCoroTask, Chain)
+{
+  int result = 0;
+
+  bokasafn::coro::spawn([](int & result) -> task<> { result = co_await twice(); }(result));
+
+  EXPECT_EQ(result, 84);
+}
+
+TEST(TestCoroTask, Exception)
+{
+  bool caught = false;
+
+  bokasafn::coro::spawn([](bool & caught) -> task<> {
+    try
+    {
+      co_await fail();
+    }
+    catch (std::runtime_error const &)
+    {
+      caught = true;
+    }
+  }(caught));
+
+  EXPECT_TRUE(caught);
+}
+
+TEST(TestCoroTask, Lazy)
+{
+  bool started = false;
+
+  auto t = [](bool & started) -> task<> {
+    started = true;
+    co_return;
+  }(started);
+
+  EXPECT_FALSE(started);
+  EXPECT_FALSE(t.done());
+
+  bokasafn::coro::spawn(std::move(t));
+
+  EXPECT_TRUE(started);
+}
+
+TEST(TestCoroTask, Empty)
+{
+  bool caught = false;
+
+  bokasafn::coro::spawn([](bool & caught) -> task<> {
+    auto t = answer();
+    auto moved = std::move(t);
+
+    try
+    {
+      co_await t;
+    }
+    catch (bokasafn::exceptions::perror const &)
+    {
+      caught = true;
+    }
+
+    EXPECT_EQ(co_await moved, 42);
+  }(caught));
+
+  EXPECT_TRUE(caught);
+}
+
+TEST(TestCoroTask, FramePool)
+{
+  void * a = bokasafn::coro::frame_pool::allocate(100);
+  bokasafn::coro::frame_pool::deallocate(a, 100);
+
+  // Same size class, same frame
+  void * b = bokasafn::coro::frame_pool::allocate(120);
+  EXPECT_EQ(a, b);
+  bokasafn::coro::frame_pool::deallocate(b, 120);
+}
+
+TEST(TestCoroTaskDeathTest, EscapedException)
+{
+  EXPECT_DEATH(bokasafn::coro::spawn([]() -> task<> { co_await fail(); }()), "");
+}
@@ -76,3 +76,89 @@ TEST(TestEpoll, Timer)
   EXPECT_EQ(test1, 1);
   EXPECT_GE(test2, 2);
 }
+
+TEST(TestEpoll, BusyPoll)
+{
+  bokasafn::epoll<20> e;
+  int ticks = 0;
+
+  e.busy_poll({.budget = 100us, .adaptive = true, .min = 10us, .max = 5ms});
+
+  // Events every 2ms: spinning pays off, the budget grows
+  e.timer(2ms, [&ticks, &e](int) {
+    if (++ticks == 20)
+      e.stop();
+    return ticks < 20;
+  });
+
+  e.start(100ms);
+
+  EXPECT_EQ(ticks, 20);
+  EXPECT_GT(e.busy_budget(), 100us);
+
+  // Events every 20ms: each spin runs dry, the budget shrinks
+  auto before = e.busy_budget();
+  ticks = 0;
+
+  e.timer(20ms, [&ticks, &e](int) {
+    if (++ticks == 5)
+      e.stop();
+    return ticks < 5;
+  });
+
+  e.start(100ms);
+
+  EXPECT_EQ(ticks, 5);
+  EXPECT_LT(e.busy_budget(), before);
+}
+
+TEST(TestEpoll, PriorityBudget)
+{
+  int a[ 2 ];
+  int b[ 2 ];
+  EXPECT_EQ(pipe(a), 0);
+  EXPECT_EQ(pipe(b), 0);
+
+  EXPECT_EQ(write(a[ 1 ], "aaaaaaaaaa", 10), 10);
+  EXPECT_EQ(write(b[ 1 ], "b", 1), 1);
+
+  bokasafn::epoll<20> e;
+  std::string log;
+  int turns = 0;
+
+  e.add(a[ 0 ], [&](int fd) {
+    char c;
+
+    ++turns;
+    do
+    {
+      if (read(fd, &c, 1) != 1)
+        break;
+      log += c;
+    } while (e.consume(1));
+
+    if (log.size() == 11)
+      e.stop();
+
+    return true;
+  });
+  e.set_budget(a[ 0 ], 2);
+
+  e.add(b[ 0 ], [&](int fd) {
+    char c;
+
+    EXPECT_EQ(read(fd, &c, 1), 1);
+    log += c;
+
+    return false;
+  });
+  e.set_priority(b[ 0 ], bokasafn::priority::high);
+
+  e.start(100ms);
+
+  for (auto fd : {a[ 0 ], a[ 1 ], b[ 0 ], b[ 1 ]})
+    close(fd);
+
+  EXPECT_EQ(log, "baaaaaaaaaa");
+  EXPECT_EQ(turns, 5);
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <bokasafn/executor.hh>
+
+namespace
+{
+
+void
+wait_for(std::atomic<int> const & counter, int expected)
+{
+  while (counter.load() != expected)
+    std::this_thread::yield();
+}
+
+} /** ! */
+
+TEST(TestExecutor, Submit)
+{
+  bokasafn::executor e(4);
+  std::atomic<int> done{0};
+
+  for (int i = 0; i < 10000; ++i)
+    e.submit([&done]() { done++; });
+
+  wait_for(done, 10000);
+
+  EXPECT_EQ(done, 10000);
+}
+
+TEST(TestExecutor, BoxedTask)
+{
+  bokasafn::executor e(2);
+  std::atomic<int> done{0};
+  std::string value;
+
+  std::string payload(100, 'x');
+  e.submit([&done, &value, payload]() {
+    value = payload;
+    done++;
+  });
+
+  wait_for(done, 1);
+
+  EXPECT_EQ(value, std::string(100, 'x'));
+}
+
+TEST(TestExecutor, BulkSubmit)
+{
+  bokasafn::executor e(2);
+  std::atomic<int> sum{0};
+  std::atomic<int> done{0};
+
+  std::vector<std::function<void()>> tasks;
+  for (int i = 1; i <= 100; ++i)
+    tasks.push_back([&sum, &done, i]() {
+      sum += i;
+      done++;
+    });
+
+  e.bulk_submit(tasks.begin(), tasks.end());
+  wait_for(done, 100);
+
+  EXPECT_EQ(sum, 5050);
+}
+
+TEST(TestExecutor, ForkJoin)
+{
+  bokasafn::executor e(4);
+  std::atomic<int> pending{1};
+  std::atomic<int> leaves{0};
+
+  // Binary tree of depth 12 forked from the workers, through their own deques
+  struct fork
+  {
+    bokasafn::executor * e;
+    std::atomic<int> * pending;
+    std::atomic<int> * leaves;
+    int depth;
+
+    void
+    operator()() const
+    {
+      if (depth)
+      {
+        EXPECT_GE(e->current(), 0);
+
+        pending->fetch_add(2);
+        e->submit(fork{e, pending, leaves, depth - 1});
+        e->submit(fork{e, pending, leaves, depth - 1});
+      }
+      else
+        leaves->fetch_add(1);
+
+      pending->fetch_sub(1);
+    }
+  };
+
+  e.submit(fork{&e, &pending, &leaves, 12});
+  wait_for(pending, 0);
+
+  EXPECT_EQ(leaves, 4096);
+  EXPECT_EQ(e.current(), -1);
+}
+
+TEST(TestExecutor, DrainOnDestruction)
+{
+  std::atomic<int> done{0};
+
+  {
+    bokasafn::executor e(2, true);
+
+    for (int i = 0; i < 1000; ++i)
+      e.submit([&done]() { done++; });
+  }
+
+  EXPECT_EQ(done, 1000);
+}
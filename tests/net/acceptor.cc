@@ -0,0 +1,113 @@
+#include <sys/resource.h>
+
+#include <gtest/gtest.h>
+
+#include <type_traits>
+#include <vector>
+
+#include <bokasafn/epoll.hh>
+#include <bokasafn/net/acceptor.hh>
+#include <bokasafn/net/socket.hh>
+
+using namespace std::chrono_literals;
+
+using tcp = bokasafn::net::ipv4::tcp;
+
+static_assert(!std::is_copy_constructible_v<tcp>);
+static_assert(std::is_nothrow_move_constructible_v<tcp>);
+
+TEST(TestAcceptor, Move)
+{
+  tcp a;
+  int fd = a.fd();
+
+  tcp b(std::move(a));
+  EXPECT_EQ(a.fd(), -1);
+  EXPECT_EQ(b.fd(), fd);
+
+  tcp c;
+  c = std::move(b);
+  EXPECT_EQ(b.fd(), -1);
+  EXPECT_EQ(c.fd(), fd);
+
+  // Still open: the moved-from sockets did not close it
+  EXPECT_GE(fcntl(fd, F_GETFD), 0);
+}
+
+TEST(TestAcceptor, DrainBacklog)
+{
+  tcp l;
+  l.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  l.bind({"127.0.0.1", 12361});
+  l.listen(16);
+
+  std::vector<tcp> clients(5);
+  for (auto & c : clients)
+    c.connect({"127.0.0.1", 12361});
+
+  std::vector<tcp> accepted;
+  bokasafn::net::acceptor<tcp> acceptor(l, [&accepted](tcp && s, bokasafn::net::saddr const & peer) {
+    EXPECT_EQ(peer.family(), AF_INET);
+    EXPECT_TRUE(s.get_flags() & O_NONBLOCK);
+    EXPECT_TRUE(fcntl(s.fd(), F_GETFD) & FD_CLOEXEC);
+
+    accepted.push_back(std::move(s));
+  });
+
+  int events = 0;
+  bokasafn::epoll<20> e;
+  e.add(l.fd(), [&](int) {
+    events++;
+    EXPECT_EQ(acceptor.drain(), 5u);
+    e.stop();
+    return true;
+  });
+
+  e.start(1s);
+
+  EXPECT_EQ(events, 1);
+  EXPECT_EQ(accepted.size(), 5u);
+  EXPECT_EQ(acceptor.drain(), 0u);
+}
+
+TEST(TestAcceptor, OutOfDescriptors)
+{
+  tcp l;
+  l.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  l.bind({"127.0.0.1", 12383});
+  l.listen(16);
+
+  int accepted = 0;
+  bokasafn::net::acceptor<tcp> acceptor(l, [&accepted](tcp &&, bokasafn::net::saddr const &) { accepted++; });
+
+  std::vector<tcp> clients(3);
+  for (auto & c : clients)
+    c.connect({"127.0.0.1", 12383});
+
+  // Use up every descriptor under a lowered limit
+  rlimit saved;
+  getrlimit(RLIMIT_NOFILE, &saved);
+
+  rlimit low = saved;
+  low.rlim_cur = 256;
+  ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &low), 0);
+
+  std::vector<int> filler;
+  for (int fd; (fd = dup(0)) >= 0;)
+    filler.push_back(fd);
+
+  // The backlog is emptied rather than left pending
+  EXPECT_EQ(acceptor.drain(), 0u);
+  EXPECT_EQ(acceptor.refused(), 3u);
+  EXPECT_EQ(accepted, 0);
+
+  for (auto fd : filler)
+    close(fd);
+  setrlimit(RLIMIT_NOFILE, &saved);
+
+  tcp late;
+  late.connect({"127.0.0.1", 12383});
+
+  EXPECT_EQ(acceptor.drain(), 1u);
+  EXPECT_EQ(accepted, 1);
+}
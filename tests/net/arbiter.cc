@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include <bokasafn/net/arbiter.hh>
+#include <bokasafn/net/socket.hh>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+struct packet
+{
+  std::uint64_t seq;
+  int payload;
+};
+
+packet
+make(std::uint64_t seq)
+{
+  return {bokasafn::net::htonT(seq), int(seq * 10)};
+}
+
+using arbiter_t = bokasafn::net::arbiter<bokasafn::net::sequence_at<0>, 1024>;
+
+} /** ! */
+
+TEST(TestArbiter, FirstCopyWins)
+{
+  std::vector<std::uint64_t> delivered;
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> gaps;
+
+  auto a = std::make_unique<arbiter_t>([&](std::uint64_t seq, void const * data, std::size_t, int) {
+    EXPECT_EQ(static_cast<packet const *>(data)->payload, int(seq * 10));
+    delivered.push_back(seq);
+  });
+  a->on_gap([&](std::uint64_t from, std::uint64_t count) { gaps.push_back({from, count}); });
+
+  auto t = bokasafn::stats::clock::now();
+
+  // A misses 4 and 7, B misses 4 and 5, B is 2us behind
+  for (std::uint64_t seq = 1; seq <= 10; ++seq)
+  {
+    auto p = make(seq);
+
+    if (seq != 4 && seq != 7)
+      a->process(0, &p, sizeof(p), t + seq * 10us);
+    if (seq != 4 && seq != 5)
+      a->process(1, &p, sizeof(p), t + seq * 10us + 2us);
+  }
+
+  EXPECT_EQ(delivered, (std::vector<std::uint64_t>{1, 2, 3, 5, 6, 7, 8, 9, 10}));
+  EXPECT_EQ(gaps, (std::vector<std::pair<std::uint64_t, std::uint64_t>>{{4, 1}}));
+
+  auto const & c = a->counters();
+  EXPECT_EQ(c.delivered, 9u);
+  EXPECT_EQ(c.duplicates, 7u);
+  EXPECT_EQ(c.missing, 1u);
+  EXPECT_EQ(c.won[ 0 ], 8u);
+  EXPECT_EQ(c.won[ 1 ], 1u);
+
+  EXPECT_EQ(a->lag[ 1 ].count(), 7u);
+  EXPECT_EQ(a->lag[ 1 ].max(), 2000u);
+  EXPECT_EQ(a->lag[ 0 ].count(), 0u);
+
+  // Already confirmed
+  auto old = make(2);
+  EXPECT_FALSE(a->process(0, &old, sizeof(old)));
+  EXPECT_EQ(c.stale, 1u);
+
+  // Too short for a sequence
+  EXPECT_FALSE(a->process(0, &old, 4));
+  EXPECT_EQ(c.invalid, 1u);
+}
+
+TEST(TestArbiter, SilentLine)
+{
+  std::uint64_t missing = 0;
+
+  auto a = std::make_unique<arbiter_t>([](std::uint64_t, void const *, std::size_t, int) {});
+  a->on_gap([&](std::uint64_t from, std::uint64_t count) {
+    EXPECT_EQ(from, 100u);
+    missing += count;
+  });
+
+  // B never speaks, A skips 100: the window still moves and the gap shows up
+  for (std::uint64_t seq = 0; seq < 3000; ++seq)
+  {
+    auto p = make(seq);
+
+    if (seq != 100)
+      a->process(0, &p, sizeof(p));
+  }
+
+  EXPECT_EQ(missing, 1u);
+  EXPECT_EQ(a->confirmed(), 2999u - 1024u + 1u);
+}
+
+TEST(TestArbiter, MaxAge)
+{
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> gaps;
+
+  auto a = std::make_unique<arbiter_t>([](std::uint64_t, void const *, std::size_t, int) {});
+  a->on_gap([&](std::uint64_t from, std::uint64_t count) { gaps.push_back({from, count}); });
+  a->max_age(1ms);
+
+  auto t = bokasafn::stats::clock::now();
+
+  // B never speaks, A skips 5: far from the window, only the age reports it
+  for (std::uint64_t seq = 0; seq <= 10; ++seq)
+  {
+    auto p = make(seq);
+
+    if (seq != 5)
+      a->process(0, &p, sizeof(p), t + seq * 1us);
+  }
+
+  EXPECT_TRUE(gaps.empty());
+  EXPECT_EQ(a->confirmed(), 0u);
+
+  auto p = make(11);
+  a->process(0, &p, sizeof(p), t + 2ms);
+
+  EXPECT_EQ(gaps, (std::vector<std::pair<std::uint64_t, std::uint64_t>>{{5, 1}}));
+  EXPECT_EQ(a->confirmed(), 11u);
+
+  // Nothing else comes, a timer confirms the last one
+  a->expire(t + 2ms + 500us);
+  EXPECT_EQ(a->confirmed(), 11u);
+  a->expire(t + 4ms);
+  EXPECT_EQ(a->confirmed(), 12u);
+
+  // B wakes up too late
+  auto late = make(3);
+  EXPECT_FALSE(a->process(1, &late, sizeof(late), t + 4ms));
+  EXPECT_EQ(a->counters().stale, 1u);
+  EXPECT_EQ(a->counters().missing, 1u);
+}
+
+TEST(TestArbiter, LoopbackMulticast)
+{
+  auto lo = bokasafn::net::ifindex("lo");
+  bokasafn::net::saddr ga{"239.1.1.1", 12370};
+  bokasafn::net::saddr gb{"239.1.1.2", 12371};
+
+  bokasafn::net::ipv4::udp ra;
+  ra.bind(ga);
+  ra.join_mgroup(ga, lo);
+
+  bokasafn::net::ipv4::udp rb;
+  rb.bind(gb);
+  rb.join_mgroup(gb, lo);
+
+  bokasafn::net::ipv4::udp s;
+  s.set_multicast_if(lo);
+
+  std::size_t delivered = 0;
+  auto a = std::make_unique<arbiter_t>([&](std::uint64_t, void const *, std::size_t, int) { delivered++; });
+
+  for (std::uint64_t seq = 0; seq < 100; ++seq)
+  {
+    auto p = make(seq);
+
+    if (seq % 10 != 3)
+      s.sendto(ga, &p, sizeof(p));
+    if (seq % 10 != 7)
+      s.sendto(gb, &p, sizeof(p));
+  }
+
+  a->poll(ra, 0);
+  a->poll(rb, 1);
+
+  EXPECT_EQ(delivered, 100u);
+  EXPECT_EQ(a->counters().missing, 0u);
+  EXPECT_EQ(a->counters().duplicates, 80u);
+}
+
+TEST(TestArbiter, JumpAndRestart)
+{
+  std::vector<std::uint64_t> delivered;
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> gaps;
+
+  auto a = std::make_unique<arbiter_t>(
+    [&](std::uint64_t seq, void const *, std::size_t, int) { delivered.push_back(seq); });
+  a->on_gap([&](std::uint64_t from, std::uint64_t count) { gaps.push_back({from, count}); });
+
+  for (std::uint64_t seq = 1; seq <= 10; ++seq)
+  {
+    auto p = make(seq);
+    a->process(0, &p, sizeof(p));
+    a->process(1, &p, sizeof(p));
+  }
+
+  // A corrupt or far ahead sequence jumps the window, no walk over every number
+  std::uint64_t far = std::uint64_t(1) << 50;
+  auto p = make(far);
+  EXPECT_TRUE(a->process(0, &p, sizeof(p)));
+  EXPECT_FALSE(a->process(1, &p, sizeof(p)));
+
+  // The rest of the window in front of it is reported once B confirms it too
+  ASSERT_EQ(gaps.size(), 2u);
+  EXPECT_EQ(gaps[ 0 ], std::make_pair(std::uint64_t(11), far - 1023u - 11u));
+  EXPECT_EQ(gaps[ 1 ], std::make_pair(far - 1023u, std::uint64_t(1023)));
+  EXPECT_EQ(a->confirmed(), far + 1);
+
+  // The feed restarted from 1: start over instead of dropping it as stale
+  for (std::uint64_t seq = 1; seq <= 3; ++seq)
+  {
+    auto q = make(seq);
+    EXPECT_TRUE(a->process(1, &q, sizeof(q)));
+    EXPECT_FALSE(a->process(0, &q, sizeof(q)));
+  }
+
+  auto const & c = a->counters();
+  EXPECT_EQ(c.resets, 1u);
+  EXPECT_EQ(c.stale, 0u);
+  EXPECT_EQ(delivered.back(), 3u);
+  EXPECT_EQ(a->confirmed(), 4u);
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+#include <bokasafn/net/chain.hh>
+#include <bokasafn/net/socket.hh>
+
+TEST(TestChain, Consume)
+{
+  bokasafn::net::chain c;
+  char trailer[] = "!";
+
+  c.append(std::string("head"));
+  c.append(std::vector<char>{'b', 'o', 'd', 'y'});
+  c.append_ref(trailer, 1);
+
+  EXPECT_EQ(c.size(), 9u);
+  EXPECT_EQ(c.count(), 3u);
+
+  c.consume(6);
+
+  iovec iov[ 4 ];
+  ASSERT_EQ(c.iov(iov, 4), 2u);
+  EXPECT_EQ(std::string(static_cast<char *>(iov[ 0 ].iov_base), iov[ 0 ].iov_len), "dy");
+  EXPECT_EQ(iov[ 1 ].iov_base, trailer);
+  EXPECT_EQ(c.size(), 3u);
+
+  c.consume(3);
+  EXPECT_TRUE(c.empty());
+  EXPECT_EQ(c.count(), 0u);
+}
+
+TEST(TestChain, GatherScatter)
+{
+  auto sa = bokasafn::net::saddr{"127.0.0.1", 12354};
+
+  bokasafn::net::ipv4::udp s;
+  s.bind(sa);
+
+  bokasafn::net::ipv4::udp c;
+  c.connect(sa);
+
+  bokasafn::net::chain frame;
+  frame.append(std::string("HDR:"));
+  frame.append(std::string("payload"));
+  frame.append(std::string(";"));
+
+  EXPECT_EQ(c.sendv(frame), 12);
+  EXPECT_TRUE(frame.empty());
+
+  char header[ 4 ];
+  char body[ 16 ] = {};
+  iovec iov[] = {{header, sizeof(header)}, {body, sizeof(body)}};
+
+  EXPECT_EQ(s.recvv(iov, 2), 12);
+  EXPECT_EQ(std::string(header, 4), "HDR:");
+  EXPECT_EQ(std::string(body), "payload;");
+}
+
+TEST(TestChain, PartialWrites)
+{
+  bokasafn::net::ipv4::tcp l;
+  l.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  l.bind({"127.0.0.1", 12355});
+  l.listen(1);
+
+  bokasafn::net::ipv4::tcp c;
+  c.connect({"127.0.0.1", 12355});
+
+  bokasafn::net::saddr peer;
+  auto p = l.accept(peer);
+
+  bokasafn::net::chain out;
+  std::size_t total = 0;
+  for (int i = 0; i < 64; ++i)
+  {
+    out.append(std::string(64 * 1024, char('a' + i % 26)));
+    total += 64 * 1024;
+  }
+
+  std::string received;
+  std::thread reader([&p, &received, total]() {
+    char buffer[ 65536 ];
+
+    while (received.size() < total)
+    {
+      auto n = p.recv(buffer, sizeof(buffer));
+      if (n <= 0)
+        break;
+      received.append(buffer, n);
+    }
+  });
+
+  c.add_flags(O_NONBLOCK);
+
+  {
+    bokasafn::net::cork<bokasafn::net::ipv4::tcp> corked(c);
+
+    while (!out.empty())
+    {
+      if (c.sendv(out, MSG_MORE) < 0)
+      {
+        ASSERT_EQ(errno, EAGAIN);
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  reader.join();
+
+  ASSERT_EQ(received.size(), total);
+  for (std::size_t i = 0; i < total; i += 64 * 1024)
+    EXPECT_EQ(received[ i ], char('a' + (i / (64 * 1024)) % 26));
+}
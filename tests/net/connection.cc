@@ -0,0 +1,237 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <bokasafn/epoll.hh>
+#include <bokasafn/net/connection.hh>
+#include <bokasafn/net/socket.hh>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+using tcp = bokasafn::net::ipv4::tcp;
+
+std::pair<tcp, tcp>
+connected(std::uint16_t port)
+{
+  bokasafn::net::saddr sa{"127.0.0.1", port};
+
+  tcp listener;
+  listener.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  listener.bind(sa);
+  listener.listen(1);
+
+  tcp client;
+  client.connect(sa);
+
+  bokasafn::net::saddr from;
+  return {listener.accept(from), std::move(client)};
+}
+
+} /** ! */
+
+TEST(TestConnection, Frames)
+{
+  auto [ server, client ] = connected(12378);
+
+  bokasafn::epoll<20> e;
+  bokasafn::net::connection<tcp> c(std::move(server));
+
+  // Length prefixed frames, echoed back
+  std::vector<std::string> frames;
+
+  c.attach(e, [&](char const * data, std::size_t size) {
+    std::size_t used = 0;
+
+    while (size - used >= 4)
+    {
+      std::uint32_t length;
+      std::memcpy(&length, data + used, 4);
+
+      if (size - used - 4 < length)
+        break;
+
+      frames.emplace_back(data + used + 4, length);
+      EXPECT_TRUE(c.send(data + used + 4, length));
+      used += 4 + length;
+    }
+
+    if (frames.size() == 3)
+      e.stop();
+
+    return used;
+  });
+
+  std::string stream;
+  for (std::string f : {std::string("hello"), std::string(3000, 'x'), std::string("world")})
+  {
+    std::uint32_t length = std::uint32_t(f.size());
+    stream.append(reinterpret_cast<char const *>(&length), 4);
+    stream += f;
+  }
+
+  // Sent in pieces cutting through the frames
+  for (std::size_t i = 0; i < stream.size(); i += 7)
+    client.send(stream.data() + i, std::min<std::size_t>(7, stream.size() - i));
+
+  e.start(1s);
+
+  ASSERT_EQ(frames.size(), 3u);
+  EXPECT_EQ(frames[ 0 ], "hello");
+  EXPECT_EQ(frames[ 1 ], std::string(3000, 'x'));
+  EXPECT_EQ(frames[ 2 ], "world");
+
+  std::string echo(3010, '\0');
+  std::size_t got = 0;
+  while (got < echo.size())
+    got += std::size_t(client.recv(echo.data() + got, echo.size() - got));
+
+  EXPECT_EQ(echo, "hello" + std::string(3000, 'x') + "world");
+}
+
+TEST(TestConnection, SendBackpressure)
+{
+  auto [ server, client ] = connected(12379);
+  server.set_option(bokasafn::net::option<SOL_SOCKET, SO_SNDBUF, int>(4096));
+
+  bokasafn::epoll<20> e;
+  bokasafn::net::connection<tcp> c(std::move(server), {4096, 1 << 16});
+
+  int drained = 0;
+  c.attach(e, [](char const *, std::size_t size) { return size; }, [&]() { drained++; });
+
+  // The peer does not read, the send queue fills past the high watermark then refuses
+  char chunk[ 1024 ] = {};
+  std::size_t accepted = 0;
+  while (c.send(chunk, sizeof(chunk)))
+    accepted += sizeof(chunk);
+
+  EXPECT_FALSE(c.writable());
+  EXPECT_GT(c.queued(), (1u << 16) / 4 * 3);
+  EXPECT_EQ(drained, 0);
+
+  // Read on the side of the loop, the queue drains through EPOLLOUT
+  std::size_t read = 0;
+  e.timer(1ms, [&](int) {
+    char buffer[ 65536 ];
+    ssize_t n;
+
+    while ((n = client.recv(buffer, sizeof(buffer), MSG_DONTWAIT)) > 0)
+      read += std::size_t(n);
+
+    if (read == accepted)
+    {
+      e.stop();
+      return false;
+    }
+
+    return true;
+  });
+
+  e.start(2s);
+
+  EXPECT_EQ(read, accepted);
+  EXPECT_EQ(c.queued(), 0u);
+  EXPECT_TRUE(c.writable());
+  EXPECT_EQ(drained, 1);
+}
+
+TEST(TestConnection, ReadPause)
+{
+  auto [ server, client ] = connected(12380);
+
+  bokasafn::epoll<20> e;
+  bokasafn::net::connection<tcp> c(std::move(server), {4096, 4096});
+
+  int calls = 0;
+  int closed = -1;
+
+  // Keep everything until told otherwise
+  c.attach(e, [&](char const *, std::size_t) {
+    calls++;
+    return std::size_t(0);
+  }, {}, [&](int error) { closed = error; });
+
+  std::string data(10000, 'y');
+  client.send(data.data(), data.size());
+
+  e.timer(50ms, [&](int) {
+    e.stop();
+    return false;
+  });
+  e.start(1s);
+
+  EXPECT_TRUE(c.paused());
+  EXPECT_GE(c.input().size(), 4096u / 4 * 3);
+
+  // Using the input resumes reading, then the peer leaves
+  std::size_t total = 0;
+  e.timer(5ms, [&](int) {
+    total += c.input().size();
+    c.consume(c.input().size());
+
+    if (total == data.size())
+      client.close();
+
+    if (closed >= 0)
+    {
+      e.stop();
+      return false;
+    }
+
+    return true;
+  });
+  e.start(1s);
+
+  EXPECT_EQ(total, data.size());
+  EXPECT_EQ(closed, 0);
+  EXPECT_TRUE(c.closed());
+}
+
+TEST(TestConnection, ResetReusesDescriptor)
+{
+  auto [ server, client ] = connected(12382);
+
+  bokasafn::epoll<20> e;
+  int fd = server.fd();
+  int closed = -1;
+
+  {
+    bokasafn::net::connection<tcp> c(std::move(server));
+    c.attach(e, [](char const *, std::size_t size) { return size; }, {}, [&](int error) {
+      closed = error;
+      e.stop();
+    });
+
+    // Data then a reset: input and error fire together
+    client.send("x", 1);
+    client.set_option(bokasafn::net::option<SOL_SOCKET, SO_LINGER, linger>({1, 0}));
+    client.close();
+
+    e.start(1s);
+    EXPECT_EQ(closed, ECONNRESET);
+  }
+
+  // The next descriptor with the same number only runs its own handler
+  auto [ a, b ] = bokasafn::net::local::stream::pair();
+  auto & reused = a.fd() == fd ? a : b;
+  auto & peer = a.fd() == fd ? b : a;
+  ASSERT_EQ(reused.fd(), fd);
+
+  bool called = false;
+  e.add(reused.fd(), [&](int) {
+    called = true;
+    e.stop();
+    return false;
+  });
+
+  peer.send("y", 1);
+  e.start(1s);
+
+  EXPECT_TRUE(called);
+  EXPECT_EQ(closed, ECONNRESET);
+}
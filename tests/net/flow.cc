@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <unordered_set>
+
+#include <bokasafn/net/flow.hh>
+
+using namespace std::chrono_literals;
+
+TEST(TestFlow, SaddrEquality)
+{
+  using bokasafn::net::saddr;
+
+  EXPECT_EQ(saddr("10.0.0.1", 1), saddr("10.0.0.1", 1));
+  EXPECT_FALSE(saddr("10.0.0.1", 1) == saddr("10.0.0.1", 2));
+  EXPECT_FALSE(saddr("10.0.0.1", 1) == saddr("10.0.0.2", 1));
+  EXPECT_FALSE(saddr("::1", 1) == saddr("0.0.0.1", 1));
+
+  // Differ beyond sizeof(sockaddr)
+  saddr a{"2001:db8::1", 1};
+  saddr b{"2001:db8::2", 1};
+
+  EXPECT_FALSE(a == b);
+  EXPECT_TRUE(a < b || b < a);
+  EXPECT_NE(std::hash<saddr>()(a), std::hash<saddr>()(b));
+
+  std::map<saddr, int> ordered{{a, 1}, {b, 2}, {saddr{"10.0.0.1", 2}, 3}, {saddr{"10.0.0.1", 1}, 4}};
+  EXPECT_EQ(ordered.size(), 4u);
+  EXPECT_EQ(ordered.begin()->second, 4);
+
+  // Same link-local address on two interfaces, ordered before the port
+  saddr l2{"fe80::1", 9};
+  saddr l3{"fe80::1", 1};
+  reinterpret_cast<sockaddr_in6 *>(l2.raw())->sin6_scope_id = 2;
+  reinterpret_cast<sockaddr_in6 *>(l3.raw())->sin6_scope_id = 3;
+
+  EXPECT_FALSE(l2 == l3);
+  EXPECT_TRUE(l2 < l3);
+  EXPECT_FALSE(l3 < l2);
+
+  std::map<saddr, int> scoped{{l2, 2}, {l3, 3}};
+  EXPECT_EQ(scoped.size(), 2u);
+  EXPECT_EQ(scoped.begin()->second, 2);
+}
+
+TEST(TestFlow, SaddrHash)
+{
+  std::unordered_set<bokasafn::net::saddr> peers;
+
+  for (std::uint16_t port = 0; port < 1000; ++port)
+  {
+    peers.insert({"192.168.0.1", port});
+    peers.insert({"fe80::1", port});
+  }
+
+  EXPECT_EQ(peers.size(), 2000u);
+  EXPECT_EQ(peers.count({"fe80::1", 999}), 1u);
+  EXPECT_EQ(peers.count({"fe80::2", 999}), 0u);
+}
+
+TEST(TestFlow, Table)
+{
+  bokasafn::net::flow_table<bokasafn::net::saddr, int> table(16);
+
+  for (std::uint32_t i = 0; i < 100000; ++i)
+    table.touch({in_addr_t(0x0a000000 + i), 4242}) = int(i);
+
+  EXPECT_EQ(table.size(), 100000u);
+  EXPECT_LE(table.size() * 4, table.capacity() * 3);
+
+  for (std::uint32_t i = 0; i < 100000; ++i)
+  {
+    auto v = table.find({in_addr_t(0x0a000000 + i), 4242});
+    ASSERT_NE(v, nullptr);
+    EXPECT_EQ(*v, int(i));
+  }
+
+  EXPECT_EQ(table.find({in_addr_t(0x0a000000), 4243}), nullptr);
+
+  // Erase every other, the remaining ones are still found
+  for (std::uint32_t i = 0; i < 100000; i += 2)
+    EXPECT_TRUE(table.erase({in_addr_t(0x0a000000 + i), 4242}));
+
+  EXPECT_EQ(table.size(), 50000u);
+
+  for (std::uint32_t i = 0; i < 100000; ++i)
+    EXPECT_EQ(table.find({in_addr_t(0x0a000000 + i), 4242}) != nullptr, i % 2 == 1);
+}
+
+TEST(TestFlow, Expire)
+{
+  using clock = bokasafn::net::flow_table<bokasafn::net::flow, int>::clock;
+
+  bokasafn::net::flow_table<bokasafn::net::flow, int> table;
+  bokasafn::net::saddr local{"127.0.0.1", 53};
+
+  auto t0 = clock::now();
+
+  for (std::uint16_t port = 0; port < 500; ++port)
+    table.touch({{"127.0.0.2", port}, local, IPPROTO_UDP}, t0)++;
+
+  // Half of them keep talking
+  for (std::uint16_t port = 0; port < 500; port += 2)
+    EXPECT_EQ(++table.touch({{"127.0.0.2", port}, local, IPPROTO_UDP}, t0 + 10s), 2);
+
+  // The sweep goes on where it stopped
+  std::size_t expired = 0;
+  std::size_t calls = 0;
+  auto budget = table.capacity() / 4;
+
+  for (int i = 0; i < 4; ++i)
+    expired += table.expire(t0 + 15s, 10s, budget, [&](bokasafn::net::flow const & f, int & v) {
+      EXPECT_EQ(f.source.port() % 2, 1);
+      EXPECT_EQ(v, 1);
+      calls++;
+    });
+
+  EXPECT_EQ(expired, 250u);
+  EXPECT_EQ(calls, 250u);
+  EXPECT_EQ(table.size(), 250u);
+
+  std::size_t left = 0;
+  table.for_each([&](bokasafn::net::flow const & f, int) { left += f.source.port() % 2 == 0; });
+  EXPECT_EQ(left, 250u);
+}
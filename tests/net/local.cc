@@ -0,0 +1,197 @@
+#include <gtest/gtest.h>
+
+#include <sys/wait.h>
+
+#include <vector>
+
+#include <bokasafn/net/handoff.hh>
+#include <bokasafn/net/socket.hh>
+
+TEST(TestLocal, Address)
+{
+  auto path = bokasafn::net::local::address("/tmp/bokasafn.sock");
+  EXPECT_EQ(path.family(), AF_UNIX);
+  EXPECT_EQ(path.path(), "/tmp/bokasafn.sock");
+  EXPECT_EQ(path.size(), offsetof(sockaddr_un, sun_path) + 19);
+
+  auto abstract = bokasafn::net::local::address("@bokasafn");
+  EXPECT_EQ(abstract.path(), std::string_view("\0bokasafn", 9));
+  EXPECT_EQ(abstract.size(), offsetof(sockaddr_un, sun_path) + 9);
+
+  std::stringstream ss;
+  ss << abstract;
+  EXPECT_EQ(ss.str(), "@bokasafn");
+
+  EXPECT_EQ(abstract, bokasafn::net::local::address("@bokasafn"));
+  EXPECT_FALSE(abstract == path);
+  EXPECT_NE(std::hash<bokasafn::net::local::address>()(abstract), std::hash<bokasafn::net::local::address>()(path));
+
+  EXPECT_ANY_THROW(bokasafn::net::local::address(std::string(200, 'x')));
+
+  // IP addresses do not pay for the unix path
+  static_assert(sizeof(bokasafn::net::saddr) == sizeof(sockaddr_in6));
+}
+
+TEST(TestLocal, Dgram)
+{
+  auto sa = bokasafn::net::local::address("@bokasafn-test-server");
+  auto sb = bokasafn::net::local::address("@bokasafn-test-client");
+
+  bokasafn::net::local::dgram server;
+  server.bind(sa);
+
+  bokasafn::net::local::dgram client;
+  client.bind(sb);
+
+  int data = 42;
+  ASSERT_EQ(client.sendto(sa, &data, sizeof(data)), ssize_t(sizeof(data)));
+
+  bokasafn::net::local::address from;
+  data = 0;
+  ASSERT_EQ(server.recvfrom(from, &data, sizeof(data)), ssize_t(sizeof(data)));
+  EXPECT_EQ(data, 42);
+  EXPECT_EQ(from, sb);
+
+  // An unbound sender has no name
+  bokasafn::net::local::dgram anonymous;
+  anonymous.sendto(sa, &data, sizeof(data));
+  server.recvfrom(from, &data, sizeof(data));
+  EXPECT_EQ(from.family(), AF_UNIX);
+  EXPECT_TRUE(from.path().empty());
+}
+
+TEST(TestLocal, Stream)
+{
+  char path[] = "/tmp/bokasafn-test-XXXXXX";
+  ASSERT_NE(mkdtemp(path), nullptr);
+
+  auto sa = bokasafn::net::local::address(std::string(path) + "/sock");
+
+  bokasafn::net::local::stream listener;
+  listener.bind(sa);
+  listener.listen(1);
+
+  bokasafn::net::local::stream client;
+  client.connect(sa);
+
+  bokasafn::net::local::address from;
+  auto peer = listener.accept(from);
+  EXPECT_TRUE(from.path().empty());
+
+  int data = 42;
+  client.send(&data, sizeof(data));
+  data = 0;
+  EXPECT_EQ(peer.recv(&data, sizeof(data)), ssize_t(sizeof(data)));
+  EXPECT_EQ(data, 42);
+
+  unlink((std::string(path) + "/sock").c_str());
+  rmdir(path);
+}
+
+TEST(TestLocal, PassFds)
+{
+  auto [ a, b ] = bokasafn::net::local::seqpacket::pair();
+
+  int pipes[ 2 ][ 2 ];
+  ASSERT_EQ(pipe(pipes[ 0 ]), 0);
+  ASSERT_EQ(pipe(pipes[ 1 ]), 0);
+
+  int out[] = {pipes[ 0 ][ 1 ], pipes[ 1 ][ 1 ]};
+  char tag = 'x';
+  ASSERT_EQ(a.send_fds(out, 2, &tag, 1), 1);
+
+  close(pipes[ 0 ][ 1 ]);
+  close(pipes[ 1 ][ 1 ]);
+
+  // Not enough room: nothing leaks, the error is reported
+  int in[ 2 ];
+  std::size_t count = 1;
+  EXPECT_EQ(b.recv_fds(in, count, &tag, 1), -1);
+  EXPECT_EQ(errno, EMSGSIZE);
+  EXPECT_EQ(count, 0u);
+
+  ASSERT_EQ(a.send_fds(out, 0, &tag, 1), 1);
+  count = 2;
+  EXPECT_EQ(b.recv_fds(in, count, &tag, 1), 1);
+  EXPECT_EQ(count, 0u);
+
+  // Both write ends are closed, the readers see EOF
+  char c;
+  EXPECT_EQ(read(pipes[ 0 ][ 0 ], &c, 1), 0);
+  EXPECT_EQ(read(pipes[ 1 ][ 0 ], &c, 1), 0);
+
+  close(pipes[ 0 ][ 0 ]);
+  close(pipes[ 1 ][ 0 ]);
+}
+
+TEST(TestLocal, Handoff)
+{
+  bokasafn::net::saddr sa{"127.0.0.1", 12374};
+
+  bokasafn::net::ipv4::tcp listener;
+  listener.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  listener.bind(sa);
+  listener.listen(8);
+
+  std::vector<bokasafn::net::ipv4::tcp> clients(3);
+  std::vector<bokasafn::net::ipv4::tcp> accepted;
+
+  for (auto & c : clients)
+  {
+    c.connect(sa);
+
+    bokasafn::net::saddr from;
+    accepted.push_back(listener.accept(from));
+  }
+
+  // Pending data is handed over along with the connection
+  for (int i = 0; i < 3; ++i)
+    clients[ i ].send(&i, sizeof(i));
+
+  auto [ front, worker ] = bokasafn::net::local::seqpacket::pair();
+
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+
+  if (!pid)
+  {
+    front.close();
+
+    bokasafn::net::handoff<bokasafn::net::local::seqpacket> h(worker);
+    std::size_t served = 0;
+
+    while (served < 3 && !h.closed())
+    {
+      served += h.take<bokasafn::net::ipv4::tcp>([](bokasafn::net::ipv4::tcp && s, std::uint32_t tag) {
+        int v;
+        if (s.recv(&v, sizeof(v)) == sizeof(v))
+        {
+          v = v * 10 + int(tag);
+          s.send(&v, sizeof(v));
+        }
+      });
+    }
+
+    _exit(served == 3 ? 0 : 1);
+  }
+
+  worker.close();
+
+  bokasafn::net::handoff<bokasafn::net::local::seqpacket> h(front);
+  h.give(accepted.data(), accepted.size(), 7);
+
+  for (auto const & s : accepted)
+    EXPECT_LT(s.fd(), 0);
+
+  for (int i = 0; i < 3; ++i)
+  {
+    int v = 0;
+    EXPECT_EQ(clients[ i ].recv(&v, sizeof(v)), ssize_t(sizeof(v)));
+    EXPECT_EQ(v, i * 10 + 7);
+  }
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <bokasafn/net/socket.hh>
+
+namespace
+{
+
+template <typename S>
+int
+drain(S const & s)
+{
+  int count = 0;
+  int data;
+
+  while (s.recv(&data, sizeof(data), MSG_DONTWAIT) > 0)
+    count++;
+
+  return count;
+}
+
+} /** ! */
+
+TEST(TestMulticast, Ipv4Join)
+{
+  auto lo = bokasafn::net::ifindex("lo");
+  bokasafn::net::saddr group{"239.1.2.3", 12366};
+
+  bokasafn::net::ipv4::udp r;
+  r.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  r.bind(group);
+  r.join_mgroup(group, lo);
+
+  bokasafn::net::ipv4::udp s;
+  s.set_multicast_if(lo);
+
+  int data = 42;
+  s.sendto(group, &data, sizeof(data));
+  EXPECT_EQ(drain(r), 1);
+
+  r.leave_mgroup(group, lo);
+  s.sendto(group, &data, sizeof(data));
+  EXPECT_EQ(drain(r), 0);
+}
+
+TEST(TestMulticast, Ipv4SourceSpecific)
+{
+  auto lo = bokasafn::net::ifindex("lo");
+  bokasafn::net::saddr group{"232.1.2.3", 12367};
+
+  bokasafn::net::ipv4::udp r;
+  r.bind(group);
+  r.join_mgroup(group, {"127.0.0.1", 0}, lo);
+
+  // Wanted source
+  bokasafn::net::ipv4::udp good;
+  good.set_multicast_if(lo);
+  good.bind({"127.0.0.1", 0});
+
+  // Any other source is dropped by the kernel
+  bokasafn::net::ipv4::udp bad;
+  bad.set_multicast_if(lo);
+  bad.bind({"127.0.0.2", 0});
+
+  int data = 42;
+  good.sendto(group, &data, sizeof(data));
+  bad.sendto(group, &data, sizeof(data));
+  bad.sendto(group, &data, sizeof(data));
+
+  EXPECT_EQ(drain(r), 1);
+}
+
+// No IPv6 multicast route on lo by default, the default interface loops the datagrams back
+TEST(TestMulticast, Ipv6Join)
+{
+  bokasafn::net::saddr group{"ff12::1234", 12368};
+
+  bokasafn::net::ipv6::udp r;
+  r.bind({"::", 12368});
+  r.join_mgroup(group);
+
+  bokasafn::net::ipv6::udp s;
+
+  int data = 42;
+  if (s.sendto(group, &data, sizeof(data)) < 0)
+    GTEST_SKIP() << "no IPv6 multicast route";
+
+  EXPECT_EQ(drain(r), 1);
+
+  r.leave_mgroup(group);
+  s.sendto(group, &data, sizeof(data));
+  EXPECT_EQ(drain(r), 0);
+}
+
+TEST(TestMulticast, Ipv6SourceSpecific)
+{
+  bokasafn::net::saddr group{"ff32::8000:1", 12369};
+
+  // The route also picks the source address joined below
+  bokasafn::net::ipv6::udp s;
+  if (::connect(s.fd(), group.get(), group.size()) < 0)
+    GTEST_SKIP() << "no IPv6 multicast route";
+
+  bokasafn::net::saddr source;
+  socklen_t len = sizeof(source);
+  getsockname(s.fd(), source.raw(), &len);
+
+  bokasafn::net::ipv6::udp r;
+  r.bind({"::", 12369});
+  r.join_mgroup(group, {"::1", 0});
+
+  int data = 42;
+  s.send(&data, sizeof(data));
+
+  EXPECT_EQ(drain(r), 0);
+  r.leave_mgroup(group, {"::1", 0});
+
+  r.join_mgroup(group, bokasafn::net::saddr{source.in6(), 0});
+  s.send(&data, sizeof(data));
+  EXPECT_EQ(drain(r), 1);
+}
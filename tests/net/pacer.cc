@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include <bokasafn/epoll.hh>
+#include <bokasafn/net/pacer.hh>
+#include <bokasafn/net/socket.hh>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+constexpr std::size_t DATAGRAM = 1000;
+
+} /** ! */
+
+TEST(TestPacer, Rate)
+{
+  bokasafn::net::saddr sa{"127.0.0.1", 12375};
+
+  bokasafn::net::ipv4::udp rx;
+  rx.set_option(bokasafn::net::option<SOL_SOCKET, SO_RCVBUF, int>(1 << 20));
+  rx.bind(sa);
+  rx.add_flags(O_NONBLOCK);
+
+  bokasafn::net::ipv4::udp tx;
+  tx.connect(sa);
+
+  bokasafn::epoll<20> e;
+
+  // 1MB/s, a 10KB burst: 300 datagrams need (300KB - 10KB) / 1MB/s = 290ms
+  bokasafn::net::pacer<bokasafn::net::ipv4::udp> p(tx, {1000000, 10 * DATAGRAM});
+  p.attach(e);
+
+  char buffer[ DATAGRAM ] = {};
+  for (int i = 0; i < 300; ++i)
+    ASSERT_TRUE(p.send(buffer, sizeof(buffer)));
+
+  EXPECT_GT(p.pending(), 250u);
+  EXPECT_EQ(p.queued(), p.pending() * DATAGRAM);
+
+  int received = 0;
+  auto begin = std::chrono::steady_clock::now();
+  auto end = begin;
+
+  e.add(rx.fd(), [&](int) {
+    while (rx.recv(buffer, sizeof(buffer)) > 0)
+      received++;
+
+    end = std::chrono::steady_clock::now();
+    if (received == 300)
+      e.stop();
+
+    return true;
+  });
+
+  e.start(2s);
+
+  ASSERT_EQ(received, 300);
+  EXPECT_EQ(p.pending(), 0u);
+
+  auto elapsed = std::chrono::duration<double>(end - begin).count();
+  EXPECT_GT(elapsed, 0.290 * 0.9);
+  EXPECT_LT(elapsed, 0.290 * 1.2);
+}
+
+TEST(TestPacer, Backlog)
+{
+  bokasafn::net::saddr sa{"127.0.0.1", 12376};
+
+  bokasafn::net::ipv4::udp tx;
+  tx.connect(sa);
+
+  // Without a loop the queue only moves on flush()
+  bokasafn::net::pacer<bokasafn::net::ipv4::udp> p(tx, {100000, DATAGRAM, 4 * DATAGRAM});
+
+  char buffer[ DATAGRAM ] = {};
+  EXPECT_TRUE(p.send(buffer, sizeof(buffer)));
+  for (int i = 0; i < 4; ++i)
+    EXPECT_TRUE(p.send(buffer, sizeof(buffer)));
+  EXPECT_FALSE(p.send(buffer, sizeof(buffer)));
+
+  // 1000 bytes at 100KB/s
+  auto wait = p.flush();
+  EXPECT_GT(wait, 5ms);
+  EXPECT_LE(wait, 10ms + 1ms);
+
+  std::this_thread::sleep_for(wait);
+  EXPECT_GT(p.flush(), 5ms);
+  EXPECT_EQ(p.pending(), 3u);
+}
+
+TEST(TestPacer, Txtime)
+{
+  bokasafn::net::saddr sa{"127.0.0.1", 12377};
+
+  bokasafn::net::ipv4::udp rx;
+  rx.bind(sa);
+
+  bokasafn::net::ipv4::udp tx;
+  tx.connect(sa);
+
+  bokasafn::net::pacer<bokasafn::net::ipv4::udp> p(tx, {1000000});
+  if (!p.txtime())
+    GTEST_SKIP() << "no SO_TXTIME";
+
+  // Within the burst, stamped and sent now (loopback has no qdisc to hold them)
+  char buffer[ DATAGRAM ] = {};
+  for (int i = 0; i < 10; ++i)
+    EXPECT_TRUE(p.send(buffer, sizeof(buffer)));
+
+  EXPECT_EQ(p.pending(), 0u);
+
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(rx.recv(buffer, sizeof(buffer), MSG_DONTWAIT), ssize_t(DATAGRAM));
+
+  // Past the burst the bucket still queues, the stamps alone would not pace here
+  for (int i = 0; i < 100; ++i)
+    EXPECT_TRUE(p.send(buffer, sizeof(buffer)));
+
+  EXPECT_GT(p.pending(), 0u);
+
+  // fq is not there either, the kernel may refuse or accept and ignore it
+  p.max_pacing_rate();
+}
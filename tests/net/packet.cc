@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include <bokasafn/epoll.hh>
+#include <bokasafn/net/packet.hh>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+constexpr char MAGIC[] = "bokasafn-packet-ring";
+
+bool
+matches(bokasafn::net::packet::frame const & f)
+{
+  if (f.type == PACKET_OUTGOING)
+    return false;
+
+  auto data = static_cast<char const *>(f.data);
+
+  for (std::size_t i = 0; i + sizeof(MAGIC) <= f.size; ++i)
+  {
+    if (!std::memcmp(data + i, MAGIC, sizeof(MAGIC)))
+      return true;
+  }
+
+  return false;
+}
+
+bokasafn::net::packet::rx_ring::config_t const small{1 << 16, 4, 2048, 5};
+
+} /** ! */
+
+TEST(TestPacket, RxRing)
+{
+  bokasafn::net::packet::raw s;
+  if (s.fd() < 0)
+    GTEST_SKIP() << "AF_PACKET needs CAP_NET_RAW";
+
+  bokasafn::net::packet::rx_ring ring(s, small);
+  ring.bind(bokasafn::net::ifindex("lo"));
+
+  // Bound, or the ICMP port unreachable carrying the payload is captured too
+  bokasafn::net::saddr sa{"127.0.0.1", 12372};
+  bokasafn::net::ipv4::udp r;
+  r.bind(sa);
+
+  bokasafn::net::ipv4::udp c;
+
+  auto before = std::chrono::system_clock::now();
+  for (int i = 0; i < 10; ++i)
+    c.sendto(sa, MAGIC, sizeof(MAGIC));
+
+  // Blocks are handed over by the retire timeout
+  int seen = 0;
+  bokasafn::epoll<20> e;
+  ring.attach(e, [&](bokasafn::net::packet::frame const & f) {
+    if (!matches(f))
+      return;
+
+    EXPECT_GE(f.at, before);
+    EXPECT_EQ(f.size, f.wire);
+
+    if (++seen == 10)
+      e.stop();
+  });
+
+  e.start(1s);
+
+  EXPECT_EQ(seen, 10);
+}
+
+TEST(TestPacket, Fanout)
+{
+  bokasafn::net::packet::raw s1;
+  bokasafn::net::packet::raw s2;
+  if (s1.fd() < 0 || s2.fd() < 0)
+    GTEST_SKIP() << "AF_PACKET needs CAP_NET_RAW";
+
+  bokasafn::net::packet::rx_ring r1(s1, small);
+  bokasafn::net::packet::rx_ring r2(s2, small);
+
+  auto lo = bokasafn::net::ifindex("lo");
+  r1.bind(lo);
+  r2.bind(lo);
+
+  r1.fanout(4242);
+  r2.fanout(4242);
+
+  bokasafn::net::saddr sa{"127.0.0.1", 12373};
+  bokasafn::net::ipv4::udp r;
+  r.bind(sa);
+
+  for (std::uint16_t port = 0; port < 32; ++port)
+  {
+    bokasafn::net::ipv4::udp c;
+    c.bind({"127.0.0.1", std::uint16_t(20000 + port)});
+    c.sendto(sa, MAGIC, sizeof(MAGIC));
+  }
+
+  // Each frame reaches one member only
+  int seen[ 2 ] = {};
+  auto deadline = std::chrono::steady_clock::now() + 1s;
+
+  while (seen[ 0 ] + seen[ 1 ] < 32 && std::chrono::steady_clock::now() < deadline)
+  {
+    r1.poll([&](auto const & f) { seen[ 0 ] += matches(f); });
+    r2.poll([&](auto const & f) { seen[ 1 ] += matches(f); });
+  }
+
+  EXPECT_EQ(seen[ 0 ] + seen[ 1 ], 32);
+  EXPECT_GT(seen[ 0 ], 0);
+  EXPECT_GT(seen[ 1 ], 0);
+}
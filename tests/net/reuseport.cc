@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include <bokasafn/net/acceptor.hh>
+#include <bokasafn/net/reuseport.hh>
+
+TEST(TestReuseport, SteerByCpu)
+{
+  auto sa = bokasafn::net::saddr{"127.0.0.1", 12362};
+
+  bokasafn::net::listener_group<bokasafn::net::ipv4::udp> group(sa, 4);
+  group.steer_by_cpu();
+
+  // Pin the sender, loopback delivery runs on its CPU
+  cpu_set_t set, old;
+  pthread_getaffinity_np(pthread_self(), sizeof(old), &old);
+  CPU_ZERO(&set);
+  CPU_SET(sched_getcpu(), &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+  auto expected = std::size_t(sched_getcpu()) % group.size();
+
+  bokasafn::net::ipv4::udp c;
+  for (int i = 0; i < 16; ++i)
+  {
+    c.bind({"127.0.0.1", std::uint16_t(12363 + i % 2)});
+    c.sendto(sa, &i, sizeof(i));
+    c = bokasafn::net::ipv4::udp();
+  }
+
+  pthread_setaffinity_np(pthread_self(), sizeof(old), &old);
+
+  for (std::size_t i = 0; i < group.size(); ++i)
+  {
+    int count = 0;
+    int data;
+
+    while (group[ i ].recv(&data, sizeof(data), MSG_DONTWAIT) > 0)
+      count++;
+
+    EXPECT_EQ(count, i == expected ? 16 : 0);
+  }
+}
+
+TEST(TestReuseport, Workers)
+{
+  auto sa = bokasafn::net::saddr{"127.0.0.1", 12365};
+
+  bokasafn::net::listener_group<bokasafn::net::ipv4::tcp> group(sa, 2);
+
+  std::atomic<int> accepted{0};
+  std::atomic<int> pinned{0};
+  auto cpus = std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<bokasafn::net::ipv4::tcp> clients(8);
+  for (auto & c : clients)
+    c.connect(sa);
+
+  group.start([&](std::size_t i, bokasafn::net::ipv4::tcp & l) {
+    if (unsigned(sched_getcpu()) == i % cpus)
+      pinned++;
+
+    bokasafn::net::acceptor<bokasafn::net::ipv4::tcp> acceptor(l, [&](auto &&, auto const &) { accepted++; });
+    acceptor.drain();
+  });
+  group.join();
+
+  EXPECT_EQ(pinned, 2);
+  EXPECT_EQ(accepted, 8);
+}
@@ -27,13 +27,56 @@ TEST(TestNet, SaddrStatic)
   constexpr auto sa1 = bokasafn::net::saddr{};
   static_assert(sa1.family() == PF_UNSPEC);
 
-  // C++20: constexpr std::reverse
-  /*constexpr auto sa2 = */ bokasafn::net::saddr{INADDR_ANY, 12345};
-  // static_assert(sa2.family() == AF_INET);
-  // static_assert(sa2.in() == 0);
-  // static_assert(sa2.port() == 12345);
-  /*constexpr auto sa3 = */ bokasafn::net::saddr{{0}, 12345};
-  /*constexpr auto sa4 = */ bokasafn::net::saddr{in6addr_any, 12345};
+  constexpr auto sa2 = bokasafn::net::saddr{INADDR_LOOPBACK, 12345};
+  static_assert(sa2.in().s_addr == bokasafn::net::htonT(INADDR_LOOPBACK));
+  static_assert(bokasafn::net::htonT(std::uint16_t(0x1234)) == 0x3412);
+  static_assert(bokasafn::net::htonT(0x12345678u) == 0x78563412u);
+
+  // family() and port() read the sockaddr member of the union, which is not the one built here
+  // and cannot be read in a constant expression
+  constexpr auto sa3 = bokasafn::net::saddr{{0}, 12345};
+  static_assert(sa3.in().s_addr == 0);
+  constexpr auto sa4 = bokasafn::net::saddr{in6_addr IN6ADDR_ANY_INIT, 12345};
+  static_assert(sa4.in6().s6_addr[ 15 ] == 0);
+
+  constexpr auto sa5 = bokasafn::net::saddr{"10.1.2.3", 80};
+  static_assert(sa5.in().s_addr == bokasafn::net::htonT(0x0a010203u));
+
+  constexpr auto sa6 = bokasafn::net::saddr::parse("[2001:db8::ffff:1.2.3.4]:443");
+  static_assert(sa6.in6().s6_addr[ 0 ] == 0x20 && sa6.in6().s6_addr[ 1 ] == 0x01);
+  static_assert(sa6.in6().s6_addr[ 11 ] == 0xff && sa6.in6().s6_addr[ 15 ] == 4);
+}
+
+TEST(TestNet, SaddrParse)
+{
+  using bokasafn::net::saddr;
+
+  auto expect = [](char const * text, char const * str) {
+    std::stringstream ss;
+    ss << saddr::parse(text);
+    EXPECT_EQ(ss.str(), str) << text;
+  };
+
+  expect("127.0.0.1", "127.0.0.1:0");
+  expect("127.0.0.1:8080", "127.0.0.1:8080");
+  expect("::", ":::0");
+  expect("::1", "::1:0");
+  expect("[::1]:53", "::1:53");
+  expect("[fe80::1:2]", "fe80::1:2:0");
+  expect("1:2:3:4:5:6:7:8", "1:2:3:4:5:6:7:8:0");
+  expect("1::", "1:::0");
+  expect("[::ffff:10.0.0.1]:1", "::ffff:10.0.0.1:1");
+  expect("[2001:DB8::aBc]:65535", "2001:db8::abc:65535");
+
+  // Each one is rejected, as inet_pton would
+  for (auto bad : {"", "1.2.3", "1.2.3.4.5", "256.0.0.1", "01.2.3.4", "1.2.3.4:", "1.2.3.4:65536", "1.2.3.4:x",
+                   ":::", "1:::2", "1::2::3", "1:2:3:4:5:6:7:8:9", "1:2:3:4:5:6:7", ":1::", "1::2:",
+                   "12345::", "g::", "[::1", "[::1]53", "[1.2.3.4]:1", "::1.2.3.4:5", "1:2:3:4:5:6:7:1.2.3.4"})
+    EXPECT_EQ(saddr::parse(bad).family(), PF_UNSPEC) << bad;
+
+  EXPECT_EQ(saddr("10.0.0.1", 1), saddr::parse("10.0.0.1:1"));
+  EXPECT_EQ(saddr(std::string("::2"), 1), saddr::parse("[::2]:1"));
+  EXPECT_ANY_THROW(saddr("localhost", 1));
 }
 
 TEST(TestNet, SocketUDP)
@@ -69,10 +112,10 @@ TEST(TestNet, SocketTCP)
     auto p = s.accept(paddr);
     int input;
 
-    p->send(&data, sizeof(data));
-    p->recv(&input, sizeof(input));
+    p.send(&data, sizeof(data));
+    p.recv(&input, sizeof(input));
 
-    p->close();
+    p.close();
 
     EXPECT_EQ(input, data);
   });
@@ -91,3 +134,88 @@ TEST(TestNet, SocketTCP)
   s.close();
   EXPECT_EQ(input, data);
 }
+
+TEST(TestNet, SocketMmsg)
+{
+  auto sa = bokasafn::net::saddr{"127.0.0.1", 12349};
+  auto sb = bokasafn::net::saddr{"127.0.0.1", 12350};
+
+  auto s = bokasafn::net::socket<AF_INET, SOCK_DGRAM, IPPROTO_UDP>();
+  s.bind(sa);
+
+  auto c = bokasafn::net::socket<AF_INET, SOCK_DGRAM, IPPROTO_UDP>();
+  c.bind(sb);
+
+  // Odd messages read a second int past their own
+  int out[ 9 ] = {};
+  bokasafn::net::mmsg<8> tx;
+  for (int i = 0; i < 8; ++i)
+  {
+    out[ i ] = i * 10;
+    tx.set(i, sa, &out[ i ], sizeof(int) * (1 + i % 2));
+  }
+
+  EXPECT_EQ(c.sendmmsg(tx), 8);
+  EXPECT_EQ(tx.length(7), 2 * sizeof(int));
+
+  int in[ 16 ][ 2 ] = {};
+  bokasafn::net::mmsg<16> rx(in, sizeof(in[ 0 ]));
+
+  EXPECT_EQ(s.recvmmsg(rx, 16, MSG_WAITFORONE), 8);
+
+  for (int i = 0; i < 8; ++i)
+  {
+    EXPECT_EQ(rx.length(i), sizeof(int) * (1 + i % 2));
+    EXPECT_EQ(rx.flags(i), 0);
+    EXPECT_EQ(rx.addr(i).port(), 12350);
+    EXPECT_EQ(in[ i ][ 0 ], i * 10);
+  }
+
+  // Nothing left, MSG_DONTWAIT reports it at once
+  EXPECT_EQ(s.recvmmsg(rx, 16, MSG_WAITFORONE | MSG_DONTWAIT), -1);
+
+  // Counts past the batch capacity are clamped to it
+  EXPECT_EQ(c.sendmmsg(tx, 64), 8);
+  EXPECT_EQ(s.recvmmsg(rx, 64, MSG_WAITFORONE), 8);
+}
+
+TEST(TestNet, SocketGsoGro)
+{
+  auto sa = bokasafn::net::saddr{"127.0.0.1", 12351};
+
+  auto s = bokasafn::net::socket<AF_INET, SOCK_DGRAM, IPPROTO_UDP>();
+  s.set_option(bokasafn::net::udp_gro(true));
+  s.bind(sa);
+
+  auto c = bokasafn::net::socket<AF_INET, SOCK_DGRAM, IPPROTO_UDP>();
+
+  char out[ 1050 ];
+  for (std::size_t i = 0; i < sizeof(out); ++i)
+    out[ i ] = char(i / 100);
+
+  EXPECT_EQ(c.send_gso(out, sizeof(out), 100, sa), ssize_t(sizeof(out)));
+
+  // Coalesced on loopback, received as a single buffer or as plain datagrams otherwise
+  char in[ 65536 ];
+  std::size_t count = 0;
+  std::size_t total = 0;
+
+  while (total < sizeof(out))
+  {
+    bokasafn::net::segments segs;
+
+    auto n = s.recv_gro(segs, in, sizeof(in));
+    ASSERT_GT(n, 0);
+
+    for (auto seg : segs)
+    {
+      EXPECT_EQ(seg.size(), count < 10 ? 100u : 50u);
+      EXPECT_EQ(seg[ 0 ], char(count));
+      count++;
+    }
+
+    total += n;
+  }
+
+  EXPECT_EQ(count, 11u);
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <bokasafn/net/socket.hh>
+
+TEST(TestTimestamp, Timestampns)
+{
+  auto sa = bokasafn::net::saddr{"127.0.0.1", 12356};
+
+  bokasafn::net::ipv4::udp s;
+  s.set_option(bokasafn::net::so_timestampns(true));
+  s.bind(sa);
+
+  bokasafn::net::ipv4::udp c;
+
+  auto before = std::chrono::system_clock::now();
+  int data = 42;
+  c.sendto(sa, &data, sizeof(data));
+
+  int input = 0;
+  bokasafn::net::timestamps ts;
+  bokasafn::net::saddr from;
+
+  EXPECT_EQ(s.recv_timestamped(&input, sizeof(input), ts, &from), ssize_t(sizeof(input)));
+  auto after = std::chrono::system_clock::now();
+
+  EXPECT_EQ(input, 42);
+  EXPECT_EQ(from.family(), AF_INET);
+
+  EXPECT_GE(ts.software, before);
+  EXPECT_LE(ts.software, after);
+}
+
+TEST(TestTimestamp, Timestamping)
+{
+  auto sa = bokasafn::net::saddr{"127.0.0.1", 12357};
+
+  bokasafn::net::ipv4::udp s;
+  s.set_option(bokasafn::net::so_timestamping(SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE));
+  s.bind(sa);
+
+  bokasafn::net::ipv4::udp c;
+  c.set_option(bokasafn::net::so_timestamping(SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                                              SOF_TIMESTAMPING_OPT_ID));
+
+  auto before = std::chrono::system_clock::now();
+  int data = 42;
+
+  // The first datagrams after enabling stamping may go unstamped, the kernel turns it on lazily
+  bokasafn::net::timestamps rx;
+  std::uint32_t sent = 0;
+  while (!rx.stamped() && sent < 100)
+  {
+    c.sendto(sa, &data, sizeof(data));
+    sent++;
+
+    int input = 0;
+    EXPECT_EQ(s.recv_timestamped(&input, sizeof(input), rx), ssize_t(sizeof(input)));
+    EXPECT_EQ(input, 42);
+  }
+
+  ASSERT_TRUE(rx.stamped());
+  EXPECT_GE(rx.software, before);
+  EXPECT_LE(rx.software, std::chrono::system_clock::now());
+
+  // One TX stamp per datagram, numbered by OPT_ID
+  for (std::uint32_t id = 0; id < sent; ++id)
+  {
+    bokasafn::net::timestamps tx;
+
+    ASSERT_GE(c.recv_tx_timestamp(tx), 0);
+    EXPECT_EQ(tx.type, SCM_TSTAMP_SND);
+    EXPECT_EQ(tx.id, id);
+    EXPECT_GE(tx.software, before);
+    EXPECT_LE(tx.software, std::chrono::system_clock::now());
+  }
+
+  bokasafn::net::timestamps none;
+  EXPECT_EQ(c.recv_tx_timestamp(none, MSG_DONTWAIT), -1);
+}
@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <thread>
+
+#include <bokasafn/epoll.hh>
+#include <bokasafn/net/socket.hh>
+#include <bokasafn/net/transfer.hh>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+std::string
+drain(bokasafn::net::ipv4::tcp const & s, std::size_t size)
+{
+  std::string received;
+  char buffer[ 65536 ];
+
+  while (received.size() < size)
+  {
+    auto n = s.recv(buffer, sizeof(buffer));
+    if (n <= 0)
+      break;
+    received.append(buffer, n);
+  }
+
+  return received;
+}
+
+} /** ! */
+
+TEST(TestTransfer, Sendfile)
+{
+  std::string blob(4 << 20, 0);
+  for (std::size_t i = 0; i < blob.size(); ++i)
+    blob[ i ] = char(i * 7);
+
+  auto file = std::tmpfile();
+  ASSERT_EQ(std::fwrite(blob.data(), 1, blob.size(), file), blob.size());
+  std::fflush(file);
+
+  bokasafn::net::ipv4::tcp l;
+  l.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  l.bind({"127.0.0.1", 12358});
+  l.listen(1);
+
+  bokasafn::net::ipv4::tcp c;
+  c.connect({"127.0.0.1", 12358});
+  c.add_flags(O_NONBLOCK);
+
+  bokasafn::net::saddr peer;
+  auto p = l.accept(peer);
+
+  // Skip the first KB
+  std::string received;
+  std::thread reader([&]() { received = drain(p, blob.size() - 1024); });
+
+  bokasafn::epoll<20> e;
+  bokasafn::net::sendfile_transfer t(c.fd(), fileno(file), 1024, blob.size() - 1024);
+
+  int result = -1;
+  t.attach(e, [&](int err) {
+    result = err;
+    e.stop();
+  });
+
+  e.start(5s);
+  reader.join();
+  std::fclose(file);
+
+  EXPECT_EQ(result, 0);
+  EXPECT_EQ(t.left(), 0u);
+  EXPECT_TRUE(received == blob.substr(1024));
+}
+
+TEST(TestTransfer, SendfileTruncated)
+{
+  std::string blob(4096, 'x');
+
+  auto file = std::tmpfile();
+  ASSERT_EQ(std::fwrite(blob.data(), 1, blob.size(), file), blob.size());
+  std::fflush(file);
+
+  bokasafn::net::ipv4::tcp l;
+  l.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  l.bind({"127.0.0.1", 12386});
+  l.listen(1);
+
+  bokasafn::net::ipv4::tcp c;
+  c.connect({"127.0.0.1", 12386});
+  c.add_flags(O_NONBLOCK);
+
+  bokasafn::net::saddr peer;
+  auto p = l.accept(peer);
+
+  // Asks for twice what the file holds
+  bokasafn::epoll<20> e;
+  bokasafn::net::sendfile_transfer t(c.fd(), fileno(file), 0, 2 * blob.size());
+
+  int result = -1;
+  t.attach(e, [&](int err) {
+    result = err;
+    e.stop();
+  });
+
+  e.start(5s);
+  std::fclose(file);
+
+  EXPECT_EQ(result, ENODATA);
+  EXPECT_EQ(t.left(), blob.size());
+  EXPECT_TRUE(drain(p, blob.size()) == blob);
+}
+
+TEST(TestTransfer, Splice)
+{
+  std::string blob(2 << 20, 0);
+  for (std::size_t i = 0; i < blob.size(); ++i)
+    blob[ i ] = char(i * 13);
+
+  // source -> a, proxied a -> b, b -> sink
+  bokasafn::net::ipv4::tcp la;
+  la.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  la.bind({"127.0.0.1", 12359});
+  la.listen(1);
+
+  bokasafn::net::ipv4::tcp lb;
+  lb.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  lb.bind({"127.0.0.1", 12360});
+  lb.listen(1);
+
+  bokasafn::net::ipv4::tcp source;
+  source.connect({"127.0.0.1", 12359});
+
+  bokasafn::net::ipv4::tcp b;
+  b.connect({"127.0.0.1", 12360});
+
+  bokasafn::net::saddr peer;
+  auto a = la.accept(peer);
+  auto sink = lb.accept(peer);
+
+  a.add_flags(O_NONBLOCK);
+  b.add_flags(O_NONBLOCK);
+
+  std::thread writer([&]() {
+    for (std::size_t sent = 0; sent < blob.size();)
+    {
+      auto n = source.send(blob.data() + sent, blob.size() - sent);
+      if (n <= 0)
+        break;
+      sent += n;
+    }
+    source.close();
+  });
+
+  std::string received;
+  std::thread reader([&]() { received = drain(sink, blob.size()); });
+
+  bokasafn::epoll<20> e;
+  bokasafn::net::splice_transfer t(a.fd(), b.fd());
+
+  int result = -1;
+  t.attach(e, [&](int err) {
+    result = err;
+    e.stop();
+  });
+
+  e.start(5s);
+  writer.join();
+  reader.join();
+
+  EXPECT_EQ(result, 0);
+  EXPECT_EQ(t.total(), blob.size());
+  EXPECT_TRUE(received == blob);
+}
+
+TEST(TestTransfer, SpliceOutputReset)
+{
+  bokasafn::net::ipv4::tcp la;
+  la.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  la.bind({"127.0.0.1", 12384});
+  la.listen(1);
+
+  bokasafn::net::ipv4::tcp lb;
+  lb.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  lb.bind({"127.0.0.1", 12385});
+  lb.listen(1);
+
+  bokasafn::net::ipv4::tcp source;
+  source.connect({"127.0.0.1", 12384});
+
+  bokasafn::net::ipv4::tcp b;
+  b.connect({"127.0.0.1", 12385});
+
+  bokasafn::net::saddr peer;
+  auto a = la.accept(peer);
+  auto sink = lb.accept(peer);
+
+  a.add_flags(O_NONBLOCK);
+  b.add_flags(O_NONBLOCK);
+
+  bokasafn::epoll<20> e;
+  bokasafn::net::splice_transfer t(a.fd(), b.fd());
+
+  int result = -1;
+  t.attach(e, [&](int err) {
+    result = err;
+    e.stop();
+  });
+
+  // Waiting for input, the output goes away
+  sink.set_option(bokasafn::net::option<SOL_SOCKET, SO_LINGER, linger>({1, 0}));
+  sink.close();
+
+  e.start(1s);
+
+  EXPECT_EQ(result, ECONNRESET);
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include <bokasafn/epoll.hh>
+#include <bokasafn/net/zerocopy.hh>
+
+using namespace std::chrono_literals;
+
+TEST(TestNet, Zerocopy)
+{
+  bokasafn::net::ipv4::tcp l;
+  l.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  l.bind({"127.0.0.1", 12352});
+  l.listen(1);
+
+  bokasafn::net::ipv4::tcp c;
+  c.connect({"127.0.0.1", 12352});
+
+  bokasafn::net::saddr peer;
+  auto p = l.accept(peer);
+
+  std::vector<char> big(1 << 20, 'z');
+  char small[ 100 ] = {};
+  std::size_t total = big.size() + sizeof(small);
+
+  std::thread reader([&p, total]() {
+    char buffer[ 65536 ];
+    std::size_t received = 0;
+
+    while (received < total)
+    {
+      auto n = p.recv(buffer, sizeof(buffer));
+      if (n <= 0)
+        break;
+      received += n;
+    }
+
+    EXPECT_EQ(received, total);
+  });
+
+  std::vector<std::pair<void const *, bool>> released;
+
+  bokasafn::epoll<20> e;
+  bokasafn::net::zerocopy<bokasafn::net::ipv4::tcp> zc(c, [&](void const * cookie, bool copied) {
+    released.push_back({cookie, copied});
+    e.stop();
+  });
+  zc.attach(e);
+
+  std::size_t sent = 0;
+  while (sent < big.size())
+  {
+    auto n = zc.send(big.data() + sent, big.size() - sent, big.data());
+    ASSERT_GT(n, 0);
+    sent += n;
+  }
+
+  EXPECT_GE(zc.pending(), 1u);
+
+  for (int i = 0; i < 20 && zc.pending(); ++i)
+    e.start(100ms);
+
+  ASSERT_FALSE(released.empty());
+  for (auto const & r : released)
+    EXPECT_EQ(r.first, big.data());
+
+  // Loopback always copies, the sender switched to plain sends
+  EXPECT_TRUE(released.back().second);
+  EXPECT_TRUE(zc.copying());
+
+  released.clear();
+  EXPECT_EQ(zc.send(small, sizeof(small)), ssize_t(sizeof(small)));
+  ASSERT_EQ(released.size(), 1u);
+  EXPECT_EQ(released[ 0 ].first, small);
+  EXPECT_EQ(zc.pending(), 0u);
+
+  reader.join();
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <bokasafn/net/socket.hh>
+#include <bokasafn/pool.hh>
+
+TEST(TestPool, AcquireRelease)
+{
+  bokasafn::buffer_pool pool(1500, 64);
+
+  EXPECT_EQ(pool.size(), 1500u);
+  EXPECT_EQ(pool.count(), 64u);
+
+  std::vector<bokasafn::buffer> buffers(64);
+  EXPECT_EQ(pool.acquire(buffers.begin(), buffers.end()), 64u);
+
+  for (auto const & b : buffers)
+  {
+    EXPECT_EQ(b.size(), 1500u);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(b.data()) % 64, 0u);
+  }
+
+  // Exhausted
+  EXPECT_FALSE(pool.acquire());
+
+  buffers.pop_back();
+  auto b = pool.acquire();
+  EXPECT_TRUE(b);
+}
+
+TEST(TestPool, Slices)
+{
+  bokasafn::buffer_pool pool(256, 1);
+
+  auto b = pool.acquire();
+  std::memcpy(b.data(), "hello world", 11);
+  b.resize(11);
+
+  auto world = b.slice(6, 5);
+  EXPECT_EQ(std::string(world.data(), world.size()), "world");
+  EXPECT_EQ(b.use_count(), 2u);
+
+  // The slice keeps the buffer out of the pool
+  b.reset();
+  EXPECT_FALSE(pool.acquire());
+
+  auto owner = world.share();
+  EXPECT_EQ(owner.get(), world.data());
+  EXPECT_EQ(world.use_count(), 2u);
+
+  world.reset();
+  EXPECT_FALSE(pool.acquire());
+
+  owner.reset();
+  EXPECT_TRUE(pool.acquire());
+}
+
+TEST(TestPool, RemoteRelease)
+{
+  bokasafn::buffer_pool pool(64, 1024);
+
+  // Buffers filled here, released by a consumer thread, come back here
+  for (int round = 0; round < 10; ++round)
+  {
+    std::vector<bokasafn::buffer> buffers(1024);
+    ASSERT_EQ(pool.acquire(buffers.begin(), buffers.end()), 1024u);
+
+    std::thread consumer([ b = std::move(buffers) ]() mutable { b.clear(); });
+    consumer.join();
+  }
+
+  std::vector<bokasafn::buffer> buffers(1024);
+  EXPECT_EQ(pool.acquire(buffers.begin(), buffers.end()), 1024u);
+}
+
+TEST(TestPool, ThreadExit)
+{
+  bokasafn::buffer_pool pool(64, 256);
+
+  // A thread keeping free buffers in its list gives them back when leaving
+  std::thread([&]() {
+    std::vector<bokasafn::buffer> buffers(256);
+    EXPECT_EQ(pool.acquire(buffers.begin(), buffers.end()), 256u);
+  }).join();
+
+  std::vector<bokasafn::buffer> buffers(256);
+  EXPECT_EQ(pool.acquire(buffers.begin(), buffers.end()), 256u);
+}
+
+TEST(TestPool, Recvmmsg)
+{
+  bokasafn::buffer_pool pool(2048, 8);
+
+  bokasafn::net::saddr sa{"127.0.0.1", 12381};
+
+  bokasafn::net::ipv4::udp rx;
+  rx.bind(sa);
+
+  bokasafn::net::ipv4::udp tx;
+  for (int i = 0; i < 8; ++i)
+    tx.sendto(sa, &i, sizeof(i));
+
+  // Received straight into pooled buffers, then handed over without a copy
+  bokasafn::buffer buffers[ 8 ];
+  bokasafn::net::mmsg<8> batch;
+
+  pool.acquire(std::begin(buffers), std::end(buffers));
+  for (std::size_t i = 0; i < 8; ++i)
+    batch.set(i, buffers[ i ].data(), buffers[ i ].size());
+
+  ASSERT_EQ(rx.recvmmsg(batch), 8);
+
+  bokasafn::net::chain out;
+  for (std::size_t i = 0; i < 8; ++i)
+  {
+    buffers[ i ].resize(batch.length(i));
+
+    int v;
+    std::memcpy(&v, buffers[ i ].data(), sizeof(v));
+    EXPECT_EQ(v, int(i));
+
+    out.append(std::move(buffers[ i ]));
+  }
+
+  EXPECT_EQ(out.size(), 8 * sizeof(int));
+  EXPECT_EQ(out.count(), 8u);
+
+  // Held by the chain until consumed
+  EXPECT_EQ(pool.acquire(std::begin(buffers), std::end(buffers)), 0u);
+
+  out.consume(sizeof(int) * 3);
+  EXPECT_EQ(pool.acquire(std::begin(buffers), std::end(buffers)), 3u);
+}
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include <bokasafn/scheduler.hh>
+
+using namespace std::literals::chrono_literals;
+
+TEST(TestScheduler, After)
+{
+  bokasafn::scheduler s;
+  std::atomic<int> value{0};
+
+  auto h = s.after(10ms, [&value]() { value = 42; });
+  h.wait();
+
+  EXPECT_EQ(value, 42);
+  EXPECT_FALSE(h.active());
+}
+
+TEST(TestScheduler, Cancel)
+{
+  bokasafn::scheduler s;
+  std::atomic<int> value{0};
+
+  auto h = s.after(50ms, [&value]() { value = 42; });
+  h.cancel();
+  h.wait();
+
+  std::this_thread::sleep_for(100ms);
+
+  EXPECT_EQ(value, 0);
+}
+
+TEST(TestScheduler, Ordering)
+{
+  bokasafn::scheduler s;
+  std::vector<int> order;
+
+  auto c = s.after(30ms, [&order]() { order.push_back(3); });
+  s.after(10ms, [&order]() { order.push_back(1); });
+  s.after(20ms, [&order]() { order.push_back(2); });
+  c.wait();
+
+  EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
+
+TEST(TestScheduler, EveryDoesNotDrift)
+{
+  bokasafn::scheduler s;
+  std::atomic<int> ticks{0};
+
+  // Each tick costs 20ms of a 50ms period, a sleep_for loop would only tick 7 times
+  auto h = s.every(50ms, [&ticks]() {
+    ticks++;
+    std::this_thread::sleep_for(20ms);
+  });
+
+  std::this_thread::sleep_for(525ms);
+  h.cancel();
+  h.wait();
+
+  EXPECT_EQ(ticks, 10);
+}
+
+TEST(TestScheduler, ManyTimers)
+{
+  bokasafn::scheduler s;
+  std::atomic<int> fired{0};
+  std::vector<bokasafn::scheduler::handle> handles;
+
+  for (int i = 0; i < 10000; ++i)
+    handles.push_back(s.after(std::chrono::milliseconds(10 + i % 20), [&fired]() { fired++; }));
+
+  for (std::size_t i = 0; i < handles.size(); i += 2)
+    handles[ i ].cancel();
+
+  for (auto & h : handles)
+    h.wait();
+
+  EXPECT_EQ(fired, 5000);
+}
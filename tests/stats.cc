@@ -0,0 +1,89 @@
+#include <unistd.h>
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <bokasafn/epoll.hh>
+#include <bokasafn/stats.hh>
+
+using namespace std::literals::chrono_literals;
+
+TEST(TestStats, Histogram)
+{
+  bokasafn::stats::histogram h;
+
+  h.add(0);
+  h.add(1);
+  h.add(3);
+  h.add(1000);
+
+  EXPECT_EQ(h.count(), 4);
+  EXPECT_EQ(h.sum(), 1004);
+  EXPECT_EQ(h.max(), 1000);
+  EXPECT_EQ(h.at(0), 1);
+  EXPECT_EQ(h.at(1), 1);
+  EXPECT_EQ(h.at(2), 1);
+  EXPECT_EQ(h.at(10), 1);
+  EXPECT_EQ(h.quantile(0.5), 1);
+}
+
+TEST(TestStats, SlowRing)
+{
+  bokasafn::stats::slow_ring<4> r;
+
+  for (int i = 0; i < 6; ++i)
+    r.push(i, std::chrono::nanoseconds(i), bokasafn::stats::clock::now());
+
+  std::vector<int> fds;
+  r.dump([&fds](bokasafn::stats::slow_t const & e) { fds.push_back(e.fd); });
+
+  EXPECT_EQ(r.total(), 6);
+  EXPECT_EQ(fds, (std::vector<int>{2, 3, 4, 5}));
+}
+
+TEST(TestStats, Epoll)
+{
+  int p[ 2 ];
+  EXPECT_EQ(pipe(p), 0);
+  EXPECT_EQ(write(p[ 1 ], "a", 1), 1);
+
+  bokasafn::epoll<20, bokasafn::stats::recorder<>> e;
+  e.stats().slow_threshold(1ms);
+  e.stats().tag(p[ 0 ], 42);
+
+  e.add(p[ 0 ], [](int fd) {
+    char c;
+    EXPECT_EQ(read(fd, &c, 1), 1);
+
+    std::this_thread::sleep_for(5ms);
+    return false;
+  });
+
+  int ticks = 0;
+  e.timer(20ms, [&ticks, &e](int) {
+    if (++ticks == 3)
+      e.stop();
+    return ticks < 3;
+  });
+
+  e.start(100ms);
+
+  close(p[ 0 ]);
+  close(p[ 1 ]);
+
+  auto & s = e.stats();
+
+  EXPECT_GE(s.batches.count(), 4);
+  EXPECT_GE(s.lag.count(), 4);
+  EXPECT_EQ(s.lateness.count(), 3);
+
+  ASSERT_EQ(s.handlers().count(42), 1);
+  EXPECT_EQ(s.handlers().at(42).calls, 1);
+  EXPECT_GE(s.handlers().at(42).max, 5ms);
+
+  std::vector<int> slow;
+  s.slow.dump([&slow](bokasafn::stats::slow_t const & e) { slow.push_back(e.fd); });
+
+  EXPECT_EQ(slow, std::vector<int>{p[ 0 ]});
+}
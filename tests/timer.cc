@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <thread>
+
 #include <bokasafn/timer.hh>
 
 TEST(TestTimer, Timeout)
@@ -27,9 +29,9 @@ TEST(TestTimer, Interval)
     value++;
   });
 
-  std::this_thread::sleep_for(std::chrono::seconds(2));
+  std::this_thread::sleep_for(std::chrono::milliseconds(2500));
   t.stop();
   t.wait();
 
-  EXPECT_EQ(value, 1);
+  EXPECT_EQ(value, 2);
 }
@@ -0,0 +1,168 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <bokasafn/epoll.hh>
+#include <bokasafn/net/socket.hh>
+#include <bokasafn/uring.hh>
+
+using namespace std::literals::chrono_literals;
+
+template <typename T>
+class TestLoop : public ::testing::Test
+{
+};
+
+using LoopTypes = ::testing::Types<bokasafn::epoll<20>, bokasafn::uring<20>>;
+TYPED_TEST_CASE(TestLoop, LoopTypes);
+
+TYPED_TEST(TestLoop, FileDescriptor)
+{
+  int p[ 2 ];
+  EXPECT_EQ(pipe(p), 0);
+
+  EXPECT_GE(write(p[ 1 ], "a", 2), 0);
+  close(p[ 1 ]);
+
+  bool test1 = false;
+  bool test2 = false;
+
+  TypeParam e;
+
+  e.add(p[ 0 ], [&test1](int fd) {
+    char buffer[ 16 ];
+
+    EXPECT_GE(read(fd, buffer, sizeof(buffer)), 0);
+    test1 = true;
+
+    return true;
+  });
+  e.add(p[ 0 ], [&test2, &e](int) {
+    test2 = true;
+    e.stop();
+    return false;
+  });
+
+  e.start(500ms);
+  close(p[ 0 ]);
+
+  EXPECT_TRUE(test1);
+  EXPECT_TRUE(test2);
+}
+
+TYPED_TEST(TestLoop, Timer)
+{
+  TypeParam e;
+  int test1 = 0;
+  int test2 = 0;
+
+  e.timer(200ms, [&test1](int) {
+    test1++;
+    return false;
+  });
+
+  e.timer(50ms, [&test2](int) {
+    test2++;
+    return true;
+  });
+
+  e.timer(500ms, [&e](int) {
+    e.stop();
+    return false;
+  });
+
+  e.start(100ms);
+
+  EXPECT_EQ(test1, 1);
+  EXPECT_GE(test2, 5);
+}
+
+TYPED_TEST(TestLoop, RemoveTimer)
+{
+  TypeParam e;
+  int test = 0;
+
+  int id = e.timer(100ms, [&test](int) {
+    test++;
+    return true;
+  });
+
+  e.timer(50ms, [&e, id](int) {
+    e.remove(id);
+    return false;
+  });
+
+  e.timer(300ms, [&e](int) {
+    e.stop();
+    return false;
+  });
+
+  e.start(100ms);
+
+  EXPECT_EQ(test, 0);
+}
+
+TEST(TestUring, MultishotRecv)
+{
+  bokasafn::uring<20, 16, 64> e;
+  auto sa = bokasafn::net::saddr{"127.0.0.1", 12346};
+
+  auto s = bokasafn::net::ipv4::udp();
+  s.bind(sa);
+
+  auto c = bokasafn::net::ipv4::udp();
+  for (int i = 0; i < 64; ++i)
+    c.sendto(sa, &i, sizeof(i));
+
+  int count = 0;
+  int sum = 0;
+
+  e.recv(s.fd(), [&](int, void const * data, std::size_t size) {
+    EXPECT_EQ(size, sizeof(int));
+
+    sum += *static_cast<int const *>(data);
+    if (++count == 64)
+      e.stop();
+
+    return true;
+  });
+
+  e.start(1s);
+
+  EXPECT_EQ(count, 64);
+  EXPECT_EQ(sum, 63 * 64 / 2);
+}
+
+TEST(TestUring, MultishotAccept)
+{
+  bokasafn::uring<20> e;
+
+  auto s = bokasafn::net::ipv4::tcp();
+  s.set_option(bokasafn::net::option<SOL_SOCKET, SO_REUSEADDR, int>(true));
+  s.bind({"127.0.0.1", 12347});
+  s.listen(8);
+
+  int accepted = 0;
+
+  e.accept(s.fd(), [&](int, int fd) {
+    EXPECT_TRUE(fcntl(fd, F_GETFL) & O_NONBLOCK);
+    close(fd);
+
+    if (++accepted == 3)
+      e.stop();
+
+    return true;
+  });
+
+  bokasafn::net::ipv4::tcp c1, c2, c3;
+  c1.connect({"127.0.0.1", 12347});
+  c2.connect({"127.0.0.1", 12347});
+  c3.connect({"127.0.0.1", 12347});
+
+  e.start(1s);
+
+  EXPECT_EQ(accepted, 3);
+}
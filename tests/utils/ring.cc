@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+#include <bokasafn/utils/ring.hh>
+
+TEST(TestRing, Mirrored)
+{
+  bokasafn::utils::mirrored_ring ring(100);
+
+  auto capacity = ring.capacity();
+  EXPECT_EQ(capacity % std::size_t(sysconf(_SC_PAGESIZE)), 0u);
+  EXPECT_EQ(ring.space(), capacity);
+
+  // Move the head close to the end
+  ring.commit(capacity - 10);
+  ring.consume(capacity - 20);
+  EXPECT_EQ(ring.size(), 10u);
+  EXPECT_EQ(ring.space(), capacity - 10);
+
+  // A write crossing the end, contiguous from both sides
+  std::string text(100, 'x');
+  for (std::size_t i = 0; i < text.size(); ++i)
+    text[ i ] = char('a' + i % 26);
+
+  std::memcpy(ring.room(), text.data(), text.size());
+  ring.commit(text.size());
+
+  EXPECT_EQ(ring.size(), 110u);
+  EXPECT_EQ(std::string(ring.data() + 10, 100), text);
+
+  // The same bytes seen from the start of the mapping
+  ring.consume(20);
+  EXPECT_EQ(std::string(ring.data(), 90), text.substr(10));
+
+  ring.consume(90);
+  EXPECT_TRUE(ring.empty());
+  EXPECT_EQ(ring.space(), capacity);
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include <bokasafn/epoll.hh>
+#include <bokasafn/utils/signal.hh>
+
+using namespace std::literals::chrono_literals;
+
+TEST(TestSignal, SignalSource)
+{
+  bokasafn::epoll<20> e;
+  bokasafn::utils::signal_source s({SIGUSR1, SIGRTMIN});
+
+  unsigned usr1 = 0;
+  unsigned rt = 0;
+  int calls = 0;
+
+  s.on(SIGUSR1, [&](signalfd_siginfo const & info, unsigned count) {
+    EXPECT_EQ(info.ssi_signo, unsigned(SIGUSR1));
+    usr1 += count;
+    calls++;
+  });
+  s.on(SIGRTMIN, [&](signalfd_siginfo const &, unsigned count) {
+    rt += count;
+    calls++;
+  });
+  s.attach(e);
+
+  // Blocked: nothing is delivered before the loop reads them
+  raise(SIGUSR1);
+  raise(SIGRTMIN);
+  raise(SIGRTMIN);
+  raise(SIGRTMIN);
+
+  e.timer(50ms, [&e](int) {
+    e.stop();
+    return false;
+  });
+
+  e.start(100ms);
+
+  EXPECT_EQ(usr1, 1);
+  EXPECT_EQ(rt, 3);
+  EXPECT_EQ(calls, 2);
+}
+
+TEST(TestSignal, InvalidSignal)
+{
+  bokasafn::utils::signal_source s({SIGUSR2});
+
+  EXPECT_ANY_THROW(s.on(0, [](signalfd_siginfo const &, unsigned) {}));
+  EXPECT_ANY_THROW(s.on(bokasafn::utils::signal_source::MAX_SIGNALS, [](signalfd_siginfo const &, unsigned) {}));
+}
+
+TEST(TestSignal, PendingDiscarded)
+{
+  {
+    bokasafn::utils::signal_source s({SIGUSR1});
+
+    // Never read: unblocking must not deliver it with its default action
+    raise(SIGUSR1);
+  }
+
+  sigset_t pending;
+  sigpending(&pending);
+  EXPECT_FALSE(sigismember(&pending, SIGUSR1));
+}
+
+TEST(TestSignalDeathTest, OtherThread)
+{
+  // In a child: threads started by other tests do not block SIGUSR2
+  EXPECT_EXIT(
+    {
+      // Before the thread starts, so it inherits the mask
+      bokasafn::utils::signal_source::block({SIGUSR2});
+
+      std::atomic<bool> go = false;
+
+      // Already running when the source is created, and process-directed: a thread not blocking
+      // SIGUSR2 would take the default action
+      std::thread t([&go] {
+        while (!go)
+          std::this_thread::yield();
+        kill(getpid(), SIGUSR2);
+      });
+
+      bokasafn::epoll<20> e;
+      bokasafn::utils::signal_source s({SIGUSR2});
+
+      unsigned usr2 = 0;
+      s.on(SIGUSR2, [&](signalfd_siginfo const &, unsigned count) {
+        usr2 += count;
+        e.stop();
+      });
+      s.attach(e);
+
+      go = true;
+      t.join();
+
+      e.timer(500ms, [&e](int) {
+        e.stop();
+        return false;
+      });
+      e.start(100ms);
+
+      std::exit(usr2 == 1 ? 0 : 1);
+    },
+    ::testing::ExitedWithCode(0), "");
+}